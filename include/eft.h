@@ -0,0 +1,98 @@
+#ifndef EFT_H
+#define EFT_H
+
+#include "nr3.h"
+
+// Error-free transformations and compensated (double-double) dot products.
+// These rely on IEEE round-to-nearest and break under -ffast-math, which lets
+// the compiler reassociate away the error terms; never build files including
+// this header with it. -fno-math-errno alone is safe. Build with FMA enabled
+// (e.g. -march=native) so two_prod is a single instruction, and with -fopenmp
+// or -fopenmp-simd so the lane loop in dot2 is vectorized.
+
+#ifdef __FAST_MATH__
+#error "eft.h: compensated sums are incorrect under -ffast-math"
+#endif
+
+namespace scilib{
+
+    // a + b = s + e exactly
+    inline void two_sum(const Doub a, const Doub b, Doub &s, Doub &e) {
+        s = a + b;
+        Doub z = s - a;
+        e = (a - (s - z)) + (b - z);
+    }
+
+    // a * b = p + e exactly
+    inline void two_prod(const Doub a, const Doub b, Doub &p, Doub &e) {
+        p = a * b;
+        e = fma(a, b, -p);
+    }
+
+    // init + x.y as if accumulated in twice the working precision (Dot2 of
+    // Ogita, Rump and Oishi). The sum is split over EFT_LANES independent
+    // accumulators so the main loop vectorizes; the lanes are merged with
+    // two_sum at the end.
+    static const Int EFT_LANES = 8;
+
+    inline Doub dot2(const Doub *x, const Doub *y, const Int n, const Doub init = 0.0) {
+        Int j, l;
+        Doub p, q, e, t, s[EFT_LANES], c[EFT_LANES];
+        for (l = 0; l < EFT_LANES; l++) {
+            s[l] = c[l] = 0.0;
+        }
+        s[0] = init;
+        for (j = 0; j + EFT_LANES <= n; j += EFT_LANES) {
+#pragma omp simd private(p, q, e, t)
+            for (l = 0; l < EFT_LANES; l++) {
+                two_prod(x[j + l], y[j + l], p, e);
+                two_sum(s[l], p, t, q);
+                s[l] = t;
+                c[l] += q + e;
+            }
+        }
+        for (; j < n; j++) {
+            two_prod(x[j], y[j], p, e);
+            two_sum(s[0], p, s[0], q);
+            c[0] += q + e;
+        }
+        for (l = 1; l < EFT_LANES; l++) {
+            two_sum(s[0], s[l], s[0], q);
+            c[0] += q + c[l];
+        }
+        return s[0] + c[0];
+    }
+
+    // r = b - a x with compensated accumulation, rows shared across threads
+    inline void residual2(MatDoub_I &a, VecDoub_I &x, VecDoub_I &b, VecDoub_O &r, const Int nthreads = 1) {
+        Int i, m = a.nrows(), n = a.ncols();
+        VecDoub nx(n);
+        for (i = 0; i < n; i++) {
+            nx[i] = -x[i];
+        }
+        const Doub *px = n > 0 ? &nx[0] : NULL;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(static)
+        for (i = 0; i < m; i++) {
+            r[i] = dot2(a[i], px, n, b[i]);
+        }
+    }
+
+    // R = B - A X column by column, each entry compensated as above
+    inline void residual2(MatDoub_I &a, MatDoub_I &x, MatDoub_I &b, MatDoub_O &r, const Int nthreads = 1) {
+        Int i, c, m = a.nrows(), n = a.ncols(), nrhs = x.ncols();
+        MatDoub nxt(nrhs, n);
+        for (i = 0; i < n; i++) {
+            for (c = 0; c < nrhs; c++) {
+                nxt[c][i] = -x[i][c];
+            }
+        }
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(static) private(c)
+        for (i = 0; i < m; i++) {
+            for (c = 0; c < nrhs; c++) {
+                r[i][c] = dot2(a[i], n > 0 ? nxt[c] : NULL, n, b[i][c]);
+            }
+        }
+    }
+}
+
+#endif // EFT_H
@@ -0,0 +1,68 @@
+#ifndef KRYLOV_H
+#define KRYLOV_H
+
+#include <functional>
+#include "linalg.h"
+#include "sparse.h"
+
+namespace scilib{
+
+    // y = A x (or y = M^-1 x for a preconditioner); x and y never alias
+    typedef std::function<void(VecDoub_I &, VecDoub_O &)> LinOp;
+
+    LinOp linop(MatDoub_I &a, const Int nthreads = 1); // holds a reference to a
+    LinOp linop(const SparseMat &a, const Int nthreads = 1); // holds a reference to a
+
+    // Krylov solvers for A x = b given only the action of A. atimes applies A
+    // and asolve the preconditioner (none if empty); CG applies it on the
+    // left, BiCGSTAB and GMRES on the right. Every solve leaves its statistics
+    // in iter, err and history. err is the true relative residual
+    // ||b - A x|| / ||b|| at exit; history holds the estimate per iteration.
+    struct Krylov {
+        LinOp atimes, asolve;
+        Int nthreads; // threads for the vector kernels
+        Int iter; // iterations taken by the last solve
+        Doub err; // final relative residual
+        Bool converged;
+        vector<Doub> history;
+        Krylov(const LinOp &atimes, const LinOp &asolve = LinOp(), const Int nthreads = 1);
+        void cg(VecDoub_I &b, VecDoub_IO &x, const Doub tol = 1.0e-10, const Int itmax = 1000); // A symmetric positive-definite
+        void bicgstab(VecDoub_I &b, VecDoub_IO &x, const Doub tol = 1.0e-10, const Int itmax = 1000);
+        void gmres(VecDoub_I &b, VecDoub_IO &x, const Int restart = 30, const Doub tol = 1.0e-10, const Int itmax = 1000);
+    private:
+        void precond(VecDoub_I &r, VecDoub_O &z);
+        Doub finish(VecDoub_I &b, VecDoub_I &x, const Doub bnrm);
+    };
+
+    // Preconditioners
+
+    LinOp jacobi(MatDoub_I &a);
+    LinOp jacobi(const SparseMat &a);
+
+    // Incomplete LU with the sparsity pattern of a; every diagonal must be stored
+    struct ILU0 {
+        Int n;
+        SparseMat lu; // unit L below the diagonal, U on and above it
+        VecInt diag; // position of each diagonal entry in lu
+        ILU0(const SparseMat &a);
+        void solve(VecDoub_I &b, VecDoub_O &x);
+        LinOp op(); // holds a reference to this
+    };
+
+    // Dense LU factors of the diagonal blocks of a, applied block by block
+    struct BlockJacobi {
+        Int n, bs, nblocks;
+        vector<MatDoub*> blocks;
+        vector<LUdcmp*> lu;
+        BlockJacobi(MatDoub_I &a, const Int bs);
+        ~BlockJacobi();
+        void solve(VecDoub_I &b, VecDoub_O &x);
+        LinOp op(); // holds a reference to this
+    private:
+        void release(); // frees blocks and their factors
+        BlockJacobi(const BlockJacobi&);
+        BlockJacobi& operator=(const BlockJacobi&);
+    };
+}
+
+#endif // KRYLOV_H
@@ -10,7 +10,8 @@ namespace scilib{
         MatDoub lu; // stores decomposition
         VecInt indx; // stores permutation
         Doub d; // used by det
-        LUdcmp(MatDoub_I &a); // constructor for decomposition
+        Int nthreads; // worker threads for factorization and solves (1 = serial)
+        LUdcmp(MatDoub_I &a, Int nb = 64, Int nthreads = 1); // constructor for decomposition; nb is the panel width (nb >= n is unblocked)
         void solve(VecDoub_I &b, VecDoub_O &x); // solve single right-hand side
         void solve(MatDoub_I &b, MatDoub_O &x); // solve multiple right-hand sides
         void inverse(MatDoub_O &ainv); // inverse of matrix
@@ -19,46 +20,297 @@ namespace scilib{
         MatDoub_I& aref;
     };
 
+    // LU factored in single precision and refined to double accuracy with
+    // compensated double residuals. Falls back to a full LUdcmp when the float
+    // factors overflow or have a negligible pivot, or refinement fails to
+    // converge.
+    struct MixedLUdcmp {
+        Int n;
+        NRmatrix<float> lu; // single-precision decomposition
+        VecInt indx; // stores permutation
+        Doub d, anorm; // permutation sign, infinity norm of a
+        Int nb, nthreads;
+        Int its; // refinement steps taken by the last solve, -1 if it used the fallback
+        LUdcmp *full; // double-precision fallback, built on demand
+        MixedLUdcmp(MatDoub_I &a, Int nb = 64, Int nthreads = 1);
+        ~MixedLUdcmp();
+        void solve(VecDoub_I &b, VecDoub_O &x); // solve single right-hand side
+        void solve(MatDoub_I &b, MatDoub_O &x); // solve multiple right-hand sides
+        MatDoub_I& aref;
+    private:
+        MixedLUdcmp(const MixedLUdcmp&);
+        MixedLUdcmp& operator=(const MixedLUdcmp&);
+    };
+
+    // LU of many small n x n matrices at once (n up to a few dozen). The
+    // matrices are interleaved LANES at a time, entry (i, j) of matrix b at
+    // lu[((c n + i) n + j) LANES + l] with c = b / LANES and l = b % LANES, so
+    // that the elimination runs as SIMD over the batch instead of over the
+    // short rows; chunks are shared across threads. Pivoting is scaled partial
+    // pivoting per matrix, as LUdcmp. A zero pivot is replaced by a tiny one
+    // and flagged in sing rather than thrown. The storage is indexed by Int,
+    // so count n^2 must stay below about 2^31 (2.1M matrices at n = 32);
+    // larger batches throw and must be split.
+    struct BatchLU {
+        static const Int LANES = 8;
+        Int n, count, nchunks;
+        Int nthreads;
+        VecDoub lu; // interleaved factors
+        VecInt indx; // row interchange at step k of matrix b at (c n + k) LANES + l
+        VecInt sing; // sing[b] != 0 if matrix b is singular
+        BatchLU(const Int n, const Int count, const Int nthreads = 1); // count identity matrices
+        Doub &elem(const Int b, const Int i, const Int j) {
+            return lu[(((b / LANES) * n + i) * n + j) * LANES + b % LANES];
+        }
+        void set(const Int b, MatDoub_I &a); // copy a into slot b
+        void factor(); // factor every slot in place
+        void solve(VecDoub_IO &b); // interleaved right-hand sides, b[(c n + i) LANES + l]
+        void solve(MatDoub_I &b, MatDoub_O &x); // row k of b for matrix k
+    private:
+        VecDoub vv; // row scales
+    };
+
+    struct Cholesky {
+        Int n;
+        MatDoub el; // lower-triangular factor, a = el el^T
+        Int nthreads; // worker threads for factorization and solves (1 = serial)
+        Cholesky(MatDoub_I &a, Int nb = 64, Int nthreads = 1); // reads the lower triangle of a; nb is the panel width
+        void solve(VecDoub_I &b, VecDoub_O &x); // solve single right-hand side
+        void solve(MatDoub_I &b, MatDoub_O &x); // solve multiple right-hand sides
+        void inverse(MatDoub_O &ainv); // inverse of matrix
+        Doub logdet(); // log of determinant
+    };
+
+    struct Bandec {
+        Int n, m1, m2; // sub- and super-diagonal counts
+        MatDoub au, al; // upper factor and multipliers
+        VecInt indx; // stores permutation
+        Doub d; // used by det
+        Bandec(MatDoub_I &a, const Int mm1, const Int mm2); // a in compact n x (m1 + m2 + 1) band storage
+        void solve(VecDoub_I &b, VecDoub_O &x);
+        Doub det();
+    };
+
+    void tridag(VecDoub_I &a, VecDoub_I &b, VecDoub_I &c, VecDoub_I &r, VecDoub_O &u);
+    void tridag_cr(VecDoub_I &a, VecDoub_I &b, VecDoub_I &c, VecDoub_I &r, VecDoub_O &u, const Int nthreads = 1); // cyclic reduction
+
+    // Singular value decomposition a = u diag(w) v^T, with u m x n, w sorted
+    // in decreasing order. Options, or-ed together:
+    //   VALUES: singular values only; no vectors are accumulated and u and v
+    //           are left empty.
+    //   THIN:   for m >> n, reduce a to its n x n R factor by Householder QR
+    //           first and decompose that; u is recovered as Q u_R.
+    //   JACOBI: one-sided Jacobi instead of Golub-Reinsch, threaded over
+    //           nthreads; more accurate for the small singular values.
+    //   LAZY:   singular values only, keeping an m x n copy of a; the
+    //           vectors are formed by the first range, nullspace, solve or
+    //           prepare (or by formvectors) with the same options. That call
+    //           decomposes the copy again in full, so LAZY only pays off
+    //           when the vectors are often not needed: if they are, it costs
+    //           a values-only pass more than the eager SVD.
     struct SVD {
+        static const Int VALUES = 1;
+        static const Int THIN = 2;
+        static const Int JACOBI = 4;
+        static const Int LAZY = 8;
         Int m, n;
         MatDoub u, v;
         VecDoub w;
         Doub eps, tsh;
-        SVD(MatDoub_I &a) : m(a.nrows()), n(a.ncols()), u(a), v(n, n), w(n) {
-            eps = numeric_limits<Doub>::epsilon();
-            decompose();
-            reorder();
-            tsh = 0.5 * sqrt(m + n + 1.) * w[0] * eps;
-        }
+        Bool vectors; // u and v were computed
+        MatDoub pinv, pv, put; // pseudo-inverse cached by prepare: pinv, or pinv = pv put
+        Int pthreads; // threads used by apply
+        Bool prepared;
+        Bool lazy; // vectors still to be formed from ain
+        Int opts, nthreads;
+        MatDoub ain; // copy of a held by LAZY
+        SVD(MatDoub_I &a, const Int opts = 0, const Int nthreads = 1); // nthreads is used by THIN and JACOBI
+
+        void solve(VecDoub_I &b, VecDoub_O &x, Doub thresh = -1.);
+        void solve(MatDoub_I &b, MatDoub_O &x, Doub thresh = -1.); // b m x p, x n x p
 
-        void solve(VecDoub_I &b, VecDoub_O &x, Doub thresh);
-        void solve(MatDoub_I &b, MatDoub_O &x, Doub thresh);
+        // For many right-hand sides: prepare forms the thresholded pseudo-inverse
+        // once and apply multiplies by it with blocked products.
+        void prepare(Doub thresh = -1., const Int nthreads = 1);
+        void apply(VecDoub_I &b, VecDoub_O &x);
+        void apply(MatDoub_I &b, MatDoub_O &x); // b m x p, x n x p
 
-        Int rank(Doub thresh);
-        Int nullity(Doub thresh);
-        MatDoub range(Doub thresh);
-        MatDoub nullspace(Doub thresh);
+        Int rank(Doub thresh = -1.);
+        Int nullity(Doub thresh = -1.);
+        MatDoub range(Doub thresh = -1.);
+        MatDoub nullspace(Doub thresh = -1.);
 
         Doub inv_condition() {
                 return (w[0] <= 0. || w[n - 1] <= 0.) ? 0. : w[n - 1] / w[0];
         }
 
+        void formvectors(); // no-op if u and v are already there
         void decompose();
         void reorder();
+        void jacobi(const Int nthreads);
+        void thin(MatDoub_I &a, const Int opts, const Int nthreads);
         Doub pythag(const Doub a, const Doub b);
     };
 
+    // Eigendecomposition of a symmetric matrix, a = z diag(d) z^T with d in
+    // decreasing order; only the lower triangle of a is read. Blocked
+    // Householder reduction to tridiagonal form (panel width nb, trailing
+    // updates threaded), then implicit QL. With VALUES no vectors are formed
+    // and QL costs O(n^2). With 0 < k < n all of d is found but only the
+    // eigenvectors of the k largest eigenvalues, by inverse iteration on the
+    // tridiagonal matrix, so z is n x k and costs O(n^2 k) to form.
+    struct Symmeig {
+        static const Int VALUES = 1;
+        Int n, k; // order, eigenvectors kept
+        MatDoub z; // n x k, empty with VALUES
+        VecDoub d;
+        Bool yesvecs;
+        Symmeig(MatDoub_I &a, const Int opts = 0, const Int k = 0, const Int nthreads = 1, const Int nb = 32);
+    private:
+        void sortvecs(MatDoub &y);
+    };
+
+    // SVD and symmetric eigendecomposition of batches of 2x2 and 3x3 matrices.
+    // Matrix k is a[N N k .. N N k + N N - 1], row-major; the outputs follow
+    // the same layout with the conventions of SVD (a = u diag(w) v^T, w
+    // decreasing, u and v always orthogonal) and Symmeig (z holds the
+    // eigenvectors as columns, d decreasing). Fixed Jacobi sweeps with
+    // selects for branches, vectorized across the batch and threaded.
+    void svd2x2(VecDoub_I &a, VecDoub_O &u, VecDoub_O &w, VecDoub_O &v, const Int nthreads = 1);
+    void svd3x3(VecDoub_I &a, VecDoub_O &u, VecDoub_O &w, VecDoub_O &v, const Int nthreads = 1);
+    void symeig2x2(VecDoub_I &a, VecDoub_O &d, VecDoub_O &z, const Int nthreads = 1);
+    void symeig3x3(VecDoub_I &a, VecDoub_O &d, VecDoub_O &z, const Int nthreads = 1);
+
+    // Rank-k approximation a ~ u diag(w) v^T by randomized range finding, with
+    // u m x k, v n x k and w decreasing as in SVD. oversample extra columns
+    // and power iterations sharpen the subspace when the spectrum decays
+    // slowly; seed fixes the random test matrix.
+    struct RSVD {
+        Int m, n, k;
+        MatDoub u, v;
+        VecDoub w;
+        RSVD(MatDoub_I &a, const Int k, const Int oversample = 10, const Int power = 2, const Int nthreads = 1, const Ullong seed = 1);
+    };
+
+    // Thin SVD a = u diag(w) v^T kept up to date as rows or columns are
+    // appended (Brand 2006): a batch of p rows only costs a decomposition of
+    // an (r + p) x (r + q) matrix, q = min(p, n), plus the rotation of the
+    // current factors, never a pass over the history. maxrank > 0 truncates to that many triplets
+    // after every update. Without keepu only w and v are tracked, as PCA
+    // needs, and an added row no longer costs anything proportional to m.
+    struct IncSVD {
+        Int m, n; // rows and columns seen so far
+        Int maxrank; // rank cap, 0 for none
+        MatDoub u, v; // m x r (empty without keepu), n x r
+        VecDoub w;
+        Bool keepu;
+        Int nthreads;
+        IncSVD(MatDoub_I &a, const Int maxrank = 0, const Bool keepu = true, const Int nthreads = 1);
+        void addrows(MatDoub_I &b); // a = [a; b]
+        void addcols(MatDoub_I &c); // a = [a c], needs keepu
+    private:
+        void append(MatDoub &uu, MatDoub &vv, MatDoub_I &b, const Bool trackuu, const Int rows);
+    };
+
+    // Dense products, cache-blocked and threaded over nthreads; c is resized
+    void matmul(MatDoub_I &a, MatDoub_I &b, MatDoub_O &c, const Int nthreads = 1); // c = a b
+    void matmul_tn(MatDoub_I &a, MatDoub_I &b, MatDoub_O &c, const Int nthreads = 1); // c = a^T b
+
+    // Blocked Householder QR of an m x n matrix in place: R on and above the
+    // diagonal, the reflectors Q_k = I - tau[k] v v^T below it with v[k] = 1.
+    // Returns true if R has a zero on its diagonal.
+    Bool householder_qr(MatDoub &a, VecDoub_O &tau, Int nb = 32, const Int nthreads = 1);
+    void householder_qtmult(MatDoub_I &a, VecDoub_I &tau, VecDoub_IO &b); // b = Q^T b
+    void householder_qmult(MatDoub_I &a, VecDoub_I &tau, VecDoub_IO &b); // b = Q b
+    void householder_qtmult(MatDoub_I &a, VecDoub_I &tau, MatDoub_IO &c, Int nb = 32, const Int nthreads = 1); // c = Q^T c, blocked
+    void householder_qmult(MatDoub_I &a, VecDoub_I &tau, MatDoub_IO &c, Int nb = 32, const Int nthreads = 1); // c = Q c, blocked
+
+    // QR of [r; a] for an n x n upper-triangular r and any rows a. Reflector k
+    // touches only row k of r and the rows of a, so the cost is O(rows(a) n^2).
+    // r is overwritten by the new factor and a by the reflectors.
+    void householder_append(MatDoub &r, MatDoub &a, VecDoub_O &tau);
+    void householder_append_qtmult(MatDoub_I &a, VecDoub_I &tau, VecDoub_IO &c, VecDoub_IO &d); // [c; d] = Q^T [c; d]
+
+    // Householder QR of an m x n matrix. With formq the explicit m x m qt is
+    // built and the lower triangle of r is zeroed. Otherwise only the
+    // reflectors are kept, below the diagonal of r with their scalars in tau,
+    // and qtmult/qmult apply them in O(mn) per vector; formqt builds qt on
+    // request. The update, insert and delete methods rotate qt and r in place
+    // (forming qt first) in O(m^2 + mn) each.
     struct QRdcmp {
-        Int n;
+        Int m, n;
         MatDoub qt, r;
-        Bool sing;
-        QRdcmp(MatDoub_I& a);
-        void solve(VecDoub_I& b, VecDoub_O& x);
-        void qtmult(VecDoub_I &b, VecDoub_O &x);
+        VecDoub tau; // Q_k = I - tau[k] v v^T, v[k] = 1 and v[k+1 ..] in column k of r
+        Bool sing; // R has a zero diagonal, or m < n
+        Bool implicitq; // qt not formed, reflectors held in r
+        Int nb; // panel width (nb >= n is unblocked)
+        Int nthreads; // worker threads for the trailing updates (1 = serial)
+        QRdcmp(MatDoub_I& a, Int nb = 32, Int nthreads = 1, Bool formq = true);
+        void solve(VecDoub_I& b, VecDoub_O& x); // least squares when m > n
+        void qtmult(VecDoub_I &b, VecDoub_O &x); // x = Q^T b
+        void qmult(VecDoub_I &b, VecDoub_O &x); // x = Q b
+        void formqt(); // build qt and drop the reflectors; no-op if already formed
         void rsolve(VecDoub_I &b, VecDoub_O &x);
-        void update(VecDoub_I &u, VecDoub_I &v);
+        void update(VecDoub_I &u, VecDoub_I &v); // QR of Q (R + u v^T)
+        void update(MatDoub_I &u, MatDoub_I &v); // QR of Q (R + u v^T), u m x k, v n x k
+        void insertcol(const Int k, VecDoub_I &a); // a becomes column k of A
+        void deletecol(const Int k);
+        void insertrow(const Int k, VecDoub_I &a); // a becomes row k of A
+        void deleterow(const Int k);
         void rotate(const Int i, const Doub a, const Doub b);
     };
+
+    // Householder QR with column pivoting, A P = Q R, as a cheaper rank
+    // revealer than SVD. The diagonal of R is nonincreasing in magnitude, and
+    // rank, range and nullspace mirror the SVD methods with |r[0][0]| in place
+    // of the largest singular value.
+    struct QRPdcmp {
+        Int m, n;
+        MatDoub qr; // R on and above the diagonal, reflectors below it as in householder_qr
+        VecDoub tau;
+        VecInt perm; // column k of A P is column perm[k] of A
+        Int nthreads; // worker threads for the trailing updates (1 = serial)
+        Doub eps, tsh;
+        QRPdcmp(MatDoub_I &a, Int nb = 32, Int nthreads = 1); // nb is the block width
+        Int rank(Doub thresh = -1.);
+        MatDoub range(Doub thresh = -1.); // m x rank, orthonormal
+        MatDoub nullspace(Doub thresh = -1.); // n x (n - rank), orthonormal
+        void solve(VecDoub_I &b, VecDoub_O &x, Doub thresh = -1.); // basic least-squares solution, n - rank zeros
+    };
+
+    // Least-squares QR of a tall m x n matrix (m >= n) by TSQR: row blocks are
+    // factored independently and their R factors merged pairwise up a binary
+    // tree, each level in parallel. Q is kept implicitly as the reflectors of
+    // the leaves and tree nodes.
+    struct TSQR {
+        Int m, n, nblocks;
+        Int nthreads;
+        VecInt start; // leaf b holds rows [start[b], start[b + 1])
+        vector<MatDoub> leaf, node; // factored leaf blocks, reflectors of the tree merges
+        vector<VecDoub> leaftau, nodetau;
+        MatDoub r; // n x n upper-triangular factor
+        Bool sing;
+        TSQR(MatDoub_I &a, Int nblocks = 0, Int nthreads = 1); // nblocks = 0 uses one block per thread
+        void qtmult(VecDoub_I &b, VecDoub_O &c); // c = first n entries of Q^T b
+        void solve(VecDoub_I &b, VecDoub_O &x); // least-squares solution of a x = b
+    };
+
+    // Least squares over rows that arrive one at a time or in blocks, with
+    // exponential forgetting: a row seen t rows ago has weight lambda^t. A
+    // single row is folded into R and Q^T b with n Givens rotations in O(n^2);
+    // a block goes through householder_append. Only the n x n factor is ever
+    // held in memory. delta > 0 starts from the ridge prior R = sqrt(delta) I.
+    struct StreamQR {
+        Int n, nobs; // columns, rows seen so far
+        Doub lambda; // forgetting factor in (0, 1]
+        MatDoub r; // n x n upper-triangular factor
+        VecDoub qtb; // first n entries of Q^T b
+        Doub rss; // weighted residual sum of squares of the fit
+        StreamQR(const Int n, const Doub lambda = 1.0, const Doub delta = 0.0);
+        void add(VecDoub_I &a, const Doub b); // append one row
+        void add(MatDoub_I &a, VecDoub_I &b); // append the rows of a, oldest first
+        void solve(VecDoub_O &x);
+    };
 }
 
 
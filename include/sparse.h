@@ -0,0 +1,45 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include "nr3.h"
+
+namespace scilib{
+
+    // Compressed sparse row storage: the entries of row i are
+    // val[row_ptr[i] .. row_ptr[i + 1] - 1] with column indices col_ind, sorted
+    // within each row. The transpose of a SparseMat is the CSC form of it.
+    struct SparseMat {
+        Int nrows, ncols, nnz;
+        VecInt row_ptr; // nrows + 1 row offsets
+        VecInt col_ind; // column index of each entry
+        VecDoub val; // value of each entry
+        SparseMat();
+        SparseMat(Int m, Int n, Int nnvals); // storage only, contents not set
+        SparseMat(Int m, Int n, VecInt_I &ti, VecInt_I &tj, VecDoub_I &tv); // from triplets, duplicates summed
+        void ax(VecDoub_I &x, VecDoub_O &y, const Int nthreads = 1) const; // y = A x
+        void atx(VecDoub_I &x, VecDoub_O &y) const; // y = A^T x
+        SparseMat transpose() const;
+    };
+
+    // Fill-reducing symmetric ordering by approximate minimum degree (AMD) on
+    // the quotient graph of the pattern of a + a^T, with element absorption
+    // and supervariables. Memory stays O(nnz(a)) and no step pays for the fill
+    // it creates. perm[k] is the k-th row/column to eliminate.
+    void mindegree(const SparseMat &a, VecInt_O &perm);
+
+    // Up-looking sparse Cholesky of P A P^T, with P from mindegree. a must be
+    // symmetric positive-definite with both triangles stored. Memory is
+    // proportional to the nonzeros of the factor.
+    struct SparseCholesky {
+        Int n;
+        VecInt perm, pinv; // ordering and its inverse
+        VecInt parent; // elimination tree of P A P^T
+        VecInt lp, li; // columns of L: rows li[lp[j] .. lp[j + 1] - 1], diagonal first
+        VecDoub lx; // values of L
+        SparseCholesky(const SparseMat &a, Bool order = true);
+        void solve(VecDoub_I &b, VecDoub_O &x);
+        Doub logdet();
+    };
+}
+
+#endif // SPARSE_H
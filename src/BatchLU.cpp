@@ -0,0 +1,235 @@
+#include "../include/linalg.h"
+
+// ############ Batched Small LU ############
+
+// Inside a chunk, entry (i, j) of lane l is a[(i n + j) LANES + l], so every
+// scalar step of the elimination becomes one vector operation over LANES
+// independent matrices. Each lane pivots on its own row: the pivot search is
+// a compare-and-select per lane and the row swap a gather/scatter, skipped
+// when no lane needs it.
+
+static const Int BLU_LANES = scilib::BatchLU::LANES;
+
+// Right-looking LU with scaled partial pivoting, as LUdcmp, for
+// the BLU_LANES matrices of one chunk. vv is scratch for the row scales.
+static void blu_factor(Doub *a, Int *ip, Int *sg, Doub *vv, const Int n) {
+    const Doub TINY = 1.0e-40;
+    const Int L = BLU_LANES;
+    Int i, j, k, l;
+    Doub big[BLU_LANES], piv[BLU_LANES], mult[BLU_LANES];
+    Int imax[BLU_LANES];
+    Bool swap;
+
+    for (l = 0; l < L; l++) {
+        sg[l] = 0;
+    }
+    for (i = 0; i < n; i++) {
+        for (l = 0; l < L; l++) {
+            big[l] = 0.0;
+        }
+        for (j = 0; j < n; j++) {
+            const Doub *aij = a + (i * n + j) * L;
+#pragma omp simd
+            for (l = 0; l < L; l++) {
+                big[l] = MAX(big[l], abs(aij[l]));
+            }
+        }
+        for (l = 0; l < L; l++) {
+            if (big[l] == 0.0) {
+                sg[l] = 1;
+                big[l] = 1.0;
+            }
+            vv[i * L + l] = 1.0 / big[l];
+        }
+    }
+
+    for (k = 0; k < n; k++) {
+        const Doub *akk = a + (k * n + k) * L;
+#pragma omp simd
+        for (l = 0; l < L; l++) {
+            big[l] = vv[k * L + l] * abs(akk[l]);
+            imax[l] = k;
+        }
+        for (i = k + 1; i < n; i++) {
+            const Doub *aik = a + (i * n + k) * L;
+#pragma omp simd
+            for (l = 0; l < L; l++) {
+                Doub t = vv[i * L + l] * abs(aik[l]);
+                Bool g = t > big[l];
+                big[l] = g ? t : big[l];
+                imax[l] = g ? i : imax[l];
+            }
+        }
+        for (swap = false, l = 0; l < L; l++) {
+            swap = swap || imax[l] != k;
+        }
+        for (j = 0; j < n && swap; j++) {
+            Doub *akj = a + (k * n + j) * L;
+#pragma omp simd
+            for (l = 0; l < L; l++) {
+                Doub *arj = a + (imax[l] * n + j) * L;
+                Doub t = akj[l];
+                akj[l] = arj[l];
+                arj[l] = t;
+            }
+        }
+        for (l = 0; l < L; l++) {
+            vv[imax[l] * L + l] = vv[k * L + l];
+            ip[k * L + l] = imax[l];
+        }
+
+        Doub *pk = a + (k * n + k) * L;
+        for (l = 0; l < L; l++) {
+            if (pk[l] == 0.0) {
+                pk[l] = TINY;
+                sg[l] = 1;
+            }
+            piv[l] = pk[l];
+        }
+        for (i = k + 1; i < n; i++) {
+            Doub *aik = a + (i * n + k) * L;
+#pragma omp simd
+            for (l = 0; l < L; l++) {
+                mult[l] = aik[l] /= piv[l];
+            }
+            for (j = k + 1; j < n; j++) {
+                Doub *aij = a + (i * n + j) * L;
+                const Doub *akj = a + (k * n + j) * L;
+#pragma omp simd
+                for (l = 0; l < L; l++) {
+                    aij[l] -= mult[l] * akj[l];
+                }
+            }
+        }
+    }
+}
+
+// x = A^-1 x for the chunk, x[i LANES + l] the entries of lane l
+static void blu_solve(const Doub *a, const Int *ip, Doub *x, const Int n) {
+    const Int L = BLU_LANES;
+    Int i, j, l;
+    for (i = 0; i < n; i++) {
+        Doub *xi = x + i * L;
+#pragma omp simd
+        for (l = 0; l < L; l++) {
+            Doub *xr = x + ip[i * L + l] * L;
+            Doub t = xi[l];
+            xi[l] = xr[l];
+            xr[l] = t;
+        }
+    }
+    for (i = 1; i < n; i++) {
+        Doub *xi = x + i * L;
+        for (j = 0; j < i; j++) {
+            const Doub *aij = a + (i * n + j) * L, *xj = x + j * L;
+#pragma omp simd
+            for (l = 0; l < L; l++) {
+                xi[l] -= aij[l] * xj[l];
+            }
+        }
+    }
+    for (i = n - 1; i >= 0; i--) {
+        Doub *xi = x + i * L;
+        for (j = i + 1; j < n; j++) {
+            const Doub *aij = a + (i * n + j) * L, *xj = x + j * L;
+#pragma omp simd
+            for (l = 0; l < L; l++) {
+                xi[l] -= aij[l] * xj[l];
+            }
+        }
+        const Doub *aii = a + (i * n + i) * L;
+#pragma omp simd
+        for (l = 0; l < L; l++) {
+            xi[l] /= aii[l];
+        }
+    }
+}
+
+// Number of chunks for count matrices; throws if the interleaved storage
+// (nchunks n n LANES entries) does not fit in Int, which bounds count to
+// about 2^31 / n^2 (2.1M matrices at n = 32).
+static Int blu_chunks(const Int n, const Int count) {
+    if (n < 1 || count < 0) {
+        throw("BatchLU: bad sizes");
+    }
+    Int nchunks = count / BLU_LANES + (count % BLU_LANES != 0);
+    if (Llong(nchunks) * n * n * BLU_LANES > numeric_limits<Int>::max()) {
+        throw("BatchLU: batch too large, split it");
+    }
+    return nchunks;
+}
+
+// Every slot starts as the identity, so the padding lanes of the last chunk
+// factor without flagging anything.
+scilib::BatchLU::BatchLU(const Int n, const Int count, const Int nthreads) : n(n), count(count), nchunks(blu_chunks(n, count)), nthreads(nthreads), lu(nchunks * n * n * LANES, 0.0), indx(nchunks * n * LANES, 0), sing(nchunks * LANES, 0), vv(nchunks * n * LANES) {
+    Int c, i, l;
+    for (c = 0; c < nchunks; c++) {
+        for (i = 0; i < n; i++) {
+            for (l = 0; l < LANES; l++) {
+                lu[((c * n + i) * n + i) * LANES + l] = 1.0;
+            }
+        }
+    }
+}
+
+void scilib::BatchLU::set(const Int b, MatDoub_I &a) {
+    Int i, j;
+    if (b < 0 || b >= count || a.nrows() != n || a.ncols() != n) {
+        throw("BatchLU: bad sizes in set");
+    }
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            elem(b, i, j) = a[i][j];
+        }
+    }
+}
+
+void scilib::BatchLU::factor() {
+    Int c, nn = n * n * LANES, nl = n * LANES;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(static)
+    for (c = 0; c < nchunks; c++) {
+        blu_factor(&lu[c * nn], &indx[c * nl], &sing[c * LANES], &vv[c * nl], n);
+    }
+}
+
+// b in the interleaved layout, nchunks n LANES long
+void scilib::BatchLU::solve(VecDoub_IO &b) {
+    Int c, nn = n * n * LANES, nl = n * LANES;
+    if (b.size() != nchunks * nl) {
+        throw("BatchLU: bad sizes in solve");
+    }
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(static)
+    for (c = 0; c < nchunks; c++) {
+        blu_solve(&lu[c * nn], &indx[c * nl], &b[c * nl], n);
+    }
+}
+
+// Row k of b is the right-hand side of system k; x likewise
+void scilib::BatchLU::solve(MatDoub_I &b, MatDoub_O &x) {
+    Int c, i, l, nn = n * n * LANES, nl = n * LANES;
+    if (b.nrows() != count || b.ncols() != n) {
+        throw("BatchLU: bad sizes in solve");
+    }
+    x.resize(count, n);
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(i, l) schedule(static)
+    for (c = 0; c < nchunks; c++) {
+        Doub xc[BLU_LANES * 64], *xp = xc;
+        VecDoub big;
+        if (n > 64) {
+            big.resize(nl);
+            xp = &big[0];
+        }
+        for (l = 0; l < LANES; l++) {
+            Int k = c * LANES + l;
+            for (i = 0; i < n; i++) {
+                xp[i * LANES + l] = (k < count ? b[k][i] : 0.0);
+            }
+        }
+        blu_solve(&lu[c * nn], &indx[c * nl], xp, n);
+        for (l = 0; l < LANES && c * LANES + l < count; l++) {
+            for (i = 0; i < n; i++) {
+                x[c * LANES + l][i] = xp[i * LANES + l];
+            }
+        }
+    }
+}
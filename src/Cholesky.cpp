@@ -0,0 +1,285 @@
+#include "../include/linalg.h"
+
+// ############ Cholesky Decomposition ############
+
+// Columns of the trailing update are walked in strips of CH_JB so the panel
+// block stays in cache; rows are handed to threads in chunks of CH_ROWS.
+static const Int CH_JB = 256;
+static const Int CH_ROWS = 16;
+static const Int CH_RHS = 64;
+
+// Unblocked factorization of the diagonal block [k0, k0 + kb). Returns false
+// if the block is not positive-definite.
+static Bool chol_diag(MatDoub &el, const Int k0, const Int kb) {
+    Int i, j, k, kend = k0 + kb;
+    Doub sum;
+    for (i = k0; i < kend; i++) {
+        for (j = i; j < kend; j++) {
+            for (sum = el[j][i], k = k0; k < i; k++) {
+                sum -= el[i][k] * el[j][k];
+            }
+            if (i == j) {
+                if (sum <= 0.0) {
+                    return false;
+                }
+                el[i][i] = sqrt(sum);
+            } else {
+                el[j][i] = sum / el[i][i];
+            }
+        }
+    }
+    return true;
+}
+
+// L21 = A21 L11^-T for rows [r0, r1). lt holds L11^T so every update is a
+// contiguous row operation.
+static void chol_trsm(MatDoub &el, MatDoub_I &lt, const Int k0, const Int kb, const Int r0, const Int r1) {
+    Int i, j, p;
+    Doub tmp;
+    for (i = r0; i < r1; i++) {
+        Doub *x = el[i] + k0;
+        for (p = 0; p < kb; p++) {
+            const Doub *ltp = lt[p];
+            tmp = x[p] /= ltp[p];
+            for (j = p + 1; j < kb; j++) {
+                x[j] -= tmp * ltp[j];
+            }
+        }
+    }
+}
+
+// A22 -= L21 L21^T on the lower triangle of rows [r0, r1). w holds L21^T, with
+// column j of w corresponding to row kend + j.
+static void chol_syrk(MatDoub &el, MatDoub_I &w, const Int k0, const Int kb, const Int r0, const Int r1) {
+    Int i, j, p, jj, jn, c0, kend = k0 + kb;
+    Doub t0, t1, t2, t3;
+    for (jj = kend; jj < r1; jj += CH_JB) {
+        c0 = jj - kend; // column of w matching row jj
+        for (i = MAX(r0, jj); i < r1; i++) {
+            Doub *ai = el[i] + jj;
+            const Doub *li = el[i] + k0;
+            jn = MIN(jj + CH_JB, i + 1) - jj;
+            for (p = 0; p + 3 < kb; p += 4) {
+                const Doub *w0 = w[p] + c0, *w1 = w[p + 1] + c0, *w2 = w[p + 2] + c0, *w3 = w[p + 3] + c0;
+                t0 = li[p];
+                t1 = li[p + 1];
+                t2 = li[p + 2];
+                t3 = li[p + 3];
+                for (j = 0; j < jn; j++) {
+                    ai[j] -= t0 * w0[j] + t1 * w1[j] + t2 * w2[j] + t3 * w3[j];
+                }
+            }
+            for (; p < kb; p++) {
+                const Doub *w0 = w[p] + c0;
+                t0 = li[p];
+                for (j = 0; j < jn; j++) {
+                    ai[j] -= t0 * w0[j];
+                }
+            }
+        }
+    }
+}
+
+// Right-looking blocked factorization of the lower triangle: factor a kb x kb
+// diagonal block, solve for the panel below it, then apply the symmetric
+// rank-kb update to the trailing matrix. The panel solve and the update are
+// shared across threads by row chunks.
+scilib::Cholesky::Cholesky(MatDoub_I &a, Int nb, Int nthreads) : n(a.nrows()), el(a), nthreads(nthreads) {
+    Int i, j, k0, kb, kend, nchunk;
+    Bool ok = true;
+    if (el.ncols() != n) {
+        throw("Cholesky: need square matrix");
+    }
+    if (nb < 1) {
+        nb = 1;
+    }
+    MatDoub lt(nb, nb), w(nb, n);
+
+#pragma omp parallel num_threads(nthreads) if(nthreads > 1) private(i, j, k0, kb, kend, nchunk)
+    for (k0 = 0; k0 < n; k0 += nb) {
+        kb = MIN(nb, n - k0);
+        kend = k0 + kb;
+#pragma omp single
+        {
+            if (ok && !chol_diag(el, k0, kb)) {
+                ok = false;
+            }
+            for (i = 0; i < kb; i++) {
+                for (j = 0; j < kb; j++) {
+                    lt[i][j] = (j >= i ? el[k0 + j][k0 + i] : 0.0);
+                }
+            }
+        }
+        if (!ok) {
+            break;
+        }
+        nchunk = (n - kend + CH_ROWS - 1) / CH_ROWS;
+#pragma omp for schedule(static)
+        for (i = 0; i < nchunk; i++) {
+            chol_trsm(el, lt, k0, kb, kend + i * CH_ROWS, MIN(kend + (i + 1) * CH_ROWS, n));
+        }
+#pragma omp for schedule(static)
+        for (i = kend; i < n; i++) {
+            for (j = 0; j < kb; j++) {
+                w[j][i - kend] = el[i][k0 + j];
+            }
+        }
+#pragma omp for schedule(dynamic)
+        for (i = 0; i < nchunk; i++) {
+            chol_syrk(el, w, k0, kb, kend + i * CH_ROWS, MIN(kend + (i + 1) * CH_ROWS, n));
+        }
+    }
+    if (!ok) {
+        throw("Cholesky failed");
+    }
+    for (i = 0; i < n; i++) {
+        for (j = i + 1; j < n; j++) {
+            el[i][j] = 0.;
+        }
+    }
+}
+
+void scilib::Cholesky::solve(VecDoub_I &b, VecDoub_O &x) {
+    Int i, k;
+    Doub sum;
+    if (b.size() != n || x.size() != n) {
+        throw("Cholesky: bad lengths in solve");
+    }
+    for (i = 0; i < n; i++) {
+        for (sum = b[i], k = i - 1; k >= 0; k--) {
+            sum -= el[i][k] * x[k];
+        }
+        x[i] = sum / el[i][i];
+    }
+    for (i = n - 1; i >= 0; i--) {
+        x[i] /= el[i][i];
+        for (k = 0; k < i; k++) {
+            x[k] -= el[i][k] * x[i];
+        }
+    }
+}
+
+// b: n x m, may alias x. Columns are solved in blocks of CH_RHS with every
+// update running across a contiguous row segment.
+void scilib::Cholesky::solve(MatDoub_I &b, MatDoub_O &x) {
+    Int i, j, blk, nblk, m = b.ncols();
+    if (b.nrows() != n || x.nrows() != n || b.ncols() != x.ncols()) {
+        throw("Cholesky: bad sizes in solve");
+    }
+    if (&b != &x) {
+        for (i = 0; i < n; i++) {
+            for (j = 0; j < m; j++) {
+                x[i][j] = b[i][j];
+            }
+        }
+    }
+
+    nblk = (m + CH_RHS - 1) / CH_RHS;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1 && nblk > 1) schedule(dynamic)
+    for (blk = 0; blk < nblk; blk++) {
+        Int i, k, c, c0 = blk * CH_RHS, c1 = MIN(c0 + CH_RHS, m);
+        Doub tmp, piv;
+        for (i = 0; i < n; i++) {
+            Doub *xi = x[i];
+            const Doub *eli = el[i];
+            for (k = 0; k < i; k++) {
+                const Doub *xk = x[k];
+                tmp = eli[k];
+                for (c = c0; c < c1; c++) {
+                    xi[c] -= tmp * xk[c];
+                }
+            }
+            piv = eli[i];
+            for (c = c0; c < c1; c++) {
+                xi[c] /= piv;
+            }
+        }
+        for (i = n - 1; i >= 0; i--) {
+            Doub *xi = x[i];
+            const Doub *eli = el[i];
+            piv = eli[i];
+            for (c = c0; c < c1; c++) {
+                xi[c] /= piv;
+            }
+            for (k = 0; k < i; k++) {
+                Doub *xk = x[k];
+                tmp = eli[k];
+                for (c = c0; c < c1; c++) {
+                    xk[c] -= tmp * xi[c];
+                }
+            }
+        }
+    }
+}
+
+// A^-1 = L^-T L^-1. L^-1 is built in the lower triangle of ainv by column
+// blocks; the product row i is then written to column i of the strict upper
+// triangle (and the diagonal to a side vector), so rows never overwrite the
+// L^-1 entries other rows still read. Finally the upper triangle is mirrored.
+void scilib::Cholesky::inverse(MatDoub_O &ainv) {
+    Int i, j, blk, nblk;
+    ainv.resize(n, n);
+    VecDoub diag(n);
+
+    nblk = (n + CH_RHS - 1) / CH_RHS;
+#pragma omp parallel num_threads(nthreads) if(nthreads > 1) private(i, j)
+    {
+#pragma omp for schedule(dynamic)
+        for (blk = 0; blk < nblk; blk++) {
+            Int k, c, c0 = blk * CH_RHS, c1 = MIN(c0 + CH_RHS, n);
+            Doub tmp, piv;
+            for (i = c0; i < n; i++) {
+                Doub *xi = ainv[i];
+                const Doub *eli = el[i];
+                for (c = c0; c < c1 && c <= i; c++) {
+                    xi[c] = (c == i ? 1.0 : 0.0);
+                }
+                for (k = c0; k < i; k++) {
+                    const Doub *xk = ainv[k];
+                    tmp = eli[k];
+                    for (c = c0; c < c1 && c <= k; c++) {
+                        xi[c] -= tmp * xk[c];
+                    }
+                }
+                piv = eli[i];
+                for (c = c0; c < c1 && c <= i; c++) {
+                    xi[c] /= piv;
+                }
+            }
+        }
+
+#pragma omp for schedule(dynamic, 8)
+        for (i = 0; i < n; i++) {
+            Int k;
+            Doub tmp;
+            VecDoub sum(i + 1, 0.0);
+            for (k = i; k < n; k++) {
+                const Doub *xk = ainv[k];
+                tmp = xk[i];
+                for (j = 0; j <= i; j++) {
+                    sum[j] += tmp * xk[j];
+                }
+            }
+            for (j = 0; j < i; j++) {
+                ainv[j][i] = sum[j];
+            }
+            diag[i] = sum[i];
+        }
+
+#pragma omp for schedule(static)
+        for (i = 0; i < n; i++) {
+            ainv[i][i] = diag[i];
+            for (j = 0; j < i; j++) {
+                ainv[i][j] = ainv[j][i];
+            }
+        }
+    }
+}
+
+Doub scilib::Cholesky::logdet() {
+    Doub sum = 0.;
+    for (Int i = 0; i < n; i++) {
+        sum += log(el[i][i]);
+    }
+    return 2. * sum;
+}
@@ -0,0 +1,163 @@
+#include "../include/linalg.h"
+
+// ############ Incremental SVD ############
+
+scilib::IncSVD::IncSVD(MatDoub_I &a, const Int maxrank, const Bool keepu, const Int nthreads) : m(a.nrows()), n(a.ncols()), maxrank(maxrank), keepu(keepu), nthreads(nthreads) {
+    Int i, j, r = MIN(m, n);
+    if (maxrank > 0) {
+        r = MIN(r, maxrank);
+    }
+    SVD sv(a, SVD::THIN, nthreads);
+    w.resize(r);
+    v.resize(n, r);
+    for (j = 0; j < r; j++) {
+        w[j] = sv.w[j];
+    }
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < r; j++) {
+            v[i][j] = sv.v[i][j];
+        }
+    }
+    if (keepu) {
+        u.resize(m, r);
+        for (i = 0; i < m; i++) {
+            for (j = 0; j < r; j++) {
+                u[i][j] = sv.u[i][j];
+            }
+        }
+    }
+}
+
+void scilib::IncSVD::addrows(MatDoub_I &b) {
+    if (b.ncols() != n) {
+        throw("IncSVD: bad sizes in addrows");
+    }
+    append(u, v, b, keepu, m);
+    m += b.nrows();
+}
+
+// [a c]^T = [a^T; c^T], so the roles of u and v swap
+void scilib::IncSVD::addcols(MatDoub_I &c) {
+    Int i, j;
+    if (!keepu) {
+        throw("IncSVD: addcols needs u");
+    }
+    if (c.nrows() != m) {
+        throw("IncSVD: bad sizes in addcols");
+    }
+    MatDoub ct(c.ncols(), m);
+    for (i = 0; i < m; i++) {
+        for (j = 0; j < c.ncols(); j++) {
+            ct[j][i] = c[i][j];
+        }
+    }
+    append(v, u, ct, true, n);
+    n += c.ncols();
+}
+
+// Brand's update for uu diag(w) vv^T with the p rows of b appended, rows
+// being the current row count. b = L vv^T + K^T J^T, where L = b vv holds
+// the part of b in the span of vv and J is an orthonormal basis for the
+// remainder (projected out twice against loss of orthogonality). Then
+//   [uu 0; 0 I] [diag(w) 0; L K^T] [vv J]^T
+// and only the (r + p) x (r + q) middle matrix is decomposed. Rotating vv
+// costs O(cols (r + q) r); rotating uu, when it is tracked, O(rows r^2).
+void scilib::IncSVD::append(MatDoub &uu, MatDoub &vv, MatDoub_I &b, const Bool trackuu, const Int rows) {
+    Int i, j, l, pass, p = b.nrows(), nc = vv.nrows(), r = w.size(), q = MIN(p, nc), kk;
+    Doub sum;
+    MatDoub lp, h(b), l2;
+    matmul(b, vv, lp, nthreads);
+    l2 = lp;
+    for (pass = 0; pass < 2; pass++) {
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(j, l, sum) schedule(static)
+        for (i = 0; i < p; i++) {
+            for (j = 0; j < nc; j++) {
+                for (sum = 0.0, l = 0; l < r; l++) {
+                    sum += l2[i][l] * vv[j][l];
+                }
+                h[i][j] -= sum;
+            }
+        }
+        if (pass == 0) {
+            matmul(h, vv, l2, nthreads);
+            for (i = 0; i < p; i++) {
+                for (j = 0; j < r; j++) {
+                    lp[i][j] += l2[i][j];
+                }
+            }
+        }
+    }
+
+    // h^T = J K
+    MatDoub ht(nc, p), jb(nc, q, 0.0);
+    VecDoub tau;
+    for (i = 0; i < p; i++) {
+        for (j = 0; j < nc; j++) {
+            ht[j][i] = h[i][j];
+        }
+    }
+    householder_qr(ht, tau, 32, nthreads);
+    for (i = 0; i < q; i++) {
+        jb[i][i] = 1.0;
+    }
+    householder_qmult(ht, tau, jb, 32, nthreads);
+
+    MatDoub mid(r + p, r + q, 0.0);
+    for (j = 0; j < r; j++) {
+        mid[j][j] = w[j];
+    }
+    for (i = 0; i < p; i++) {
+        for (j = 0; j < r; j++) {
+            mid[r + i][j] = lp[i][j];
+        }
+        for (j = 0; j < q && j <= i; j++) {
+            mid[r + i][r + j] = ht[j][i];
+        }
+    }
+    SVD sm(mid);
+
+    kk = MIN(r + q, MIN(rows + p, nc));
+    if (maxrank > 0) {
+        kk = MIN(kk, maxrank);
+    }
+    MatDoub vj(nc, r + q), vm(r + q, kk);
+    for (i = 0; i < nc; i++) {
+        for (j = 0; j < r; j++) {
+            vj[i][j] = vv[i][j];
+        }
+        for (j = 0; j < q; j++) {
+            vj[i][r + j] = jb[i][j];
+        }
+    }
+    for (i = 0; i < r + q; i++) {
+        for (j = 0; j < kk; j++) {
+            vm[i][j] = sm.v[i][j];
+        }
+    }
+    matmul(vj, vm, vv, nthreads);
+
+    if (trackuu) {
+        MatDoub um(r, kk), top;
+        for (i = 0; i < r; i++) {
+            for (j = 0; j < kk; j++) {
+                um[i][j] = sm.u[i][j];
+            }
+        }
+        matmul(uu, um, top, nthreads);
+        uu.resize(rows + p, kk);
+        for (i = 0; i < rows; i++) {
+            for (j = 0; j < kk; j++) {
+                uu[i][j] = top[i][j];
+            }
+        }
+        for (i = 0; i < p; i++) {
+            for (j = 0; j < kk; j++) {
+                uu[rows + i][j] = sm.u[r + i][j];
+            }
+        }
+    }
+    w.resize(kk);
+    for (j = 0; j < kk; j++) {
+        w[j] = sm.w[j];
+    }
+}
@@ -0,0 +1,431 @@
+#include "../include/krylov.h"
+
+// ############ Vector Kernels ############
+
+static Doub kdot(VecDoub_I &x, VecDoub_I &y, const Int nthreads) {
+    Int i, n = x.size();
+    Doub sum = 0.0;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) reduction(+: sum) schedule(static)
+    for (i = 0; i < n; i++) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+// y += a x
+static void kaxpy(const Doub a, VecDoub_I &x, VecDoub_IO &y, const Int nthreads) {
+    Int i, n = x.size();
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(static)
+    for (i = 0; i < n; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+// r = b - A x
+static void kresid(const scilib::LinOp &atimes, VecDoub_I &b, VecDoub_I &x, VecDoub_O &r, const Int nthreads) {
+    Int i, n = b.size();
+    atimes(x, r);
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(static)
+    for (i = 0; i < n; i++) {
+        r[i] = b[i] - r[i];
+    }
+}
+
+// ############ Operators ############
+
+scilib::LinOp scilib::linop(MatDoub_I &a, const Int nthreads) {
+    return [&a, nthreads](VecDoub_I &x, VecDoub_O &y) {
+        Int i, j, m = a.nrows(), n = a.ncols();
+        Doub sum;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(j, sum) schedule(static)
+        for (i = 0; i < m; i++) {
+            for (sum = 0.0, j = 0; j < n; j++) {
+                sum += a[i][j] * x[j];
+            }
+            y[i] = sum;
+        }
+    };
+}
+
+scilib::LinOp scilib::linop(const SparseMat &a, const Int nthreads) {
+    return [&a, nthreads](VecDoub_I &x, VecDoub_O &y) {
+        a.ax(x, y, nthreads);
+    };
+}
+
+// ############ Krylov Solvers ############
+
+scilib::Krylov::Krylov(const LinOp &atimes, const LinOp &asolve, const Int nthreads) : atimes(atimes), asolve(asolve), nthreads(nthreads), iter(0), err(0.0), converged(false) {}
+
+void scilib::Krylov::precond(VecDoub_I &r, VecDoub_O &z) {
+    if (asolve) {
+        asolve(r, z);
+    } else {
+        z = r;
+    }
+}
+
+Doub scilib::Krylov::finish(VecDoub_I &b, VecDoub_I &x, const Doub bnrm) {
+    VecDoub r(b.size());
+    kresid(atimes, b, x, r, nthreads);
+    err = sqrt(kdot(r, r, nthreads)) / bnrm;
+    return err;
+}
+
+// Preconditioned conjugate gradients.
+void scilib::Krylov::cg(VecDoub_I &b, VecDoub_IO &x, const Doub tol, const Int itmax) {
+    Int i, n = b.size();
+    Doub alpha, beta, rz, rznew, res, bnrm;
+    VecDoub r(n), z(n), p(n), q(n);
+    history.clear();
+    converged = false;
+    iter = 0;
+    bnrm = sqrt(kdot(b, b, nthreads));
+    if (bnrm == 0.0) {
+        bnrm = 1.0;
+    }
+
+    kresid(atimes, b, x, r, nthreads);
+    if (sqrt(kdot(r, r, nthreads)) / bnrm <= tol) {
+        converged = true; // x already solves the system (e.g. b = 0)
+        finish(b, x, bnrm);
+        return;
+    }
+    precond(r, z);
+    p = z;
+    rz = kdot(r, z, nthreads);
+    while (iter < itmax) {
+        if (rz == 0.0) {
+            break; // breakdown
+        }
+        iter++;
+        atimes(p, q);
+        alpha = rz / kdot(p, q, nthreads);
+        kaxpy(alpha, p, x, nthreads);
+        kaxpy(-alpha, q, r, nthreads);
+        res = sqrt(kdot(r, r, nthreads)) / bnrm;
+        history.push_back(res);
+        if (res <= tol) {
+            converged = true;
+            break;
+        }
+        precond(r, z);
+        rznew = kdot(r, z, nthreads);
+        beta = rznew / rz;
+        rz = rznew;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(static)
+        for (i = 0; i < n; i++) {
+            p[i] = z[i] + beta * p[i];
+        }
+    }
+    finish(b, x, bnrm);
+}
+
+// BiCGSTAB with right preconditioning, so the residual it tracks is the true
+// residual of the original system.
+void scilib::Krylov::bicgstab(VecDoub_I &b, VecDoub_IO &x, const Doub tol, const Int itmax) {
+    Int i, n = b.size();
+    Doub rho = 1.0, rhonew, alpha = 1.0, omega = 1.0, beta, tt, res, bnrm;
+    VecDoub r(n), rhat(n), p(n, 0.0), v(n, 0.0), phat(n), s(n), shat(n), t(n);
+    history.clear();
+    converged = false;
+    iter = 0;
+    bnrm = sqrt(kdot(b, b, nthreads));
+    if (bnrm == 0.0) {
+        bnrm = 1.0;
+    }
+
+    kresid(atimes, b, x, r, nthreads);
+    if (sqrt(kdot(r, r, nthreads)) / bnrm <= tol) {
+        converged = true;
+        finish(b, x, bnrm);
+        return;
+    }
+    rhat = r;
+    while (iter < itmax) {
+        iter++;
+        rhonew = kdot(rhat, r, nthreads);
+        if (rhonew == 0.0) {
+            break; // breakdown
+        }
+        beta = (rhonew / rho) * (alpha / omega);
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(static)
+        for (i = 0; i < n; i++) {
+            p[i] = r[i] + beta * (p[i] - omega * v[i]);
+        }
+        precond(p, phat);
+        atimes(phat, v);
+        alpha = rhonew / kdot(rhat, v, nthreads);
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(static)
+        for (i = 0; i < n; i++) {
+            s[i] = r[i] - alpha * v[i];
+        }
+        res = sqrt(kdot(s, s, nthreads)) / bnrm;
+        if (res <= tol) {
+            kaxpy(alpha, phat, x, nthreads);
+            history.push_back(res);
+            converged = true;
+            break;
+        }
+        precond(s, shat);
+        atimes(shat, t);
+        tt = kdot(t, t, nthreads);
+        omega = (tt == 0.0 ? 0.0 : kdot(t, s, nthreads) / tt);
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(static)
+        for (i = 0; i < n; i++) {
+            x[i] += alpha * phat[i] + omega * shat[i];
+            r[i] = s[i] - omega * t[i];
+        }
+        res = sqrt(kdot(r, r, nthreads)) / bnrm;
+        history.push_back(res);
+        if (res <= tol) {
+            converged = true;
+            break;
+        }
+        if (omega == 0.0) {
+            break; // stagnation
+        }
+        rho = rhonew;
+    }
+    finish(b, x, bnrm);
+}
+
+// Restarted GMRES(m) with right preconditioning. The Arnoldi basis is built
+// with modified Gram-Schmidt and the least-squares problem is kept triangular
+// with Givens rotations, so the residual norm is known every iteration.
+void scilib::Krylov::gmres(VecDoub_I &b, VecDoub_IO &x, const Int restart, const Doub tol, const Int itmax) {
+    Int i, j, k, n = b.size(), m = MAX(restart, 1);
+    Doub beta, tmp, res, bnrm;
+    vector<VecDoub> v(m + 1, VecDoub(n));
+    MatDoub h(m + 1, m);
+    VecDoub cs(m), sn(m), g(m + 1), y(m), w(n), z(n), u(n);
+    history.clear();
+    converged = false;
+    iter = 0;
+    bnrm = sqrt(kdot(b, b, nthreads));
+    if (bnrm == 0.0) {
+        bnrm = 1.0;
+    }
+
+    while (iter < itmax) {
+        kresid(atimes, b, x, w, nthreads);
+        beta = sqrt(kdot(w, w, nthreads));
+        if (beta / bnrm <= tol) {
+            converged = true;
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            v[0][i] = w[i] / beta;
+        }
+        g[0] = beta;
+        for (i = 1; i <= m; i++) {
+            g[i] = 0.0;
+        }
+
+        for (k = 0; k < m && iter < itmax; ) {
+            iter++;
+            precond(v[k], z);
+            atimes(z, w);
+            for (i = 0; i <= k; i++) {
+                h[i][k] = kdot(w, v[i], nthreads);
+                kaxpy(-h[i][k], v[i], w, nthreads);
+            }
+            h[k + 1][k] = sqrt(kdot(w, w, nthreads));
+            if (h[k + 1][k] != 0.0) {
+                for (i = 0; i < n; i++) {
+                    v[k + 1][i] = w[i] / h[k + 1][k];
+                }
+            }
+
+            for (i = 0; i < k; i++) {
+                tmp = cs[i] * h[i][k] + sn[i] * h[i + 1][k];
+                h[i + 1][k] = -sn[i] * h[i][k] + cs[i] * h[i + 1][k];
+                h[i][k] = tmp;
+            }
+            tmp = sqrt(SQR(h[k][k]) + SQR(h[k + 1][k]));
+            if (tmp == 0.0) {
+                cs[k] = 1.0;
+                sn[k] = 0.0;
+            } else {
+                cs[k] = h[k][k] / tmp;
+                sn[k] = h[k + 1][k] / tmp;
+            }
+            h[k][k] = tmp;
+            h[k + 1][k] = 0.0;
+            g[k + 1] = -sn[k] * g[k];
+            g[k] = cs[k] * g[k];
+
+            res = abs(g[k + 1]) / bnrm;
+            history.push_back(res);
+            k++;
+            if (res <= tol || tmp == 0.0) {
+                break;
+            }
+        }
+
+        // x += M^-1 V y with H y = g
+        for (i = k - 1; i >= 0; i--) {
+            for (tmp = g[i], j = i + 1; j < k; j++) {
+                tmp -= h[i][j] * y[j];
+            }
+            y[i] = (h[i][i] == 0.0 ? 0.0 : tmp / h[i][i]);
+        }
+        for (i = 0; i < n; i++) {
+            u[i] = 0.0;
+        }
+        for (j = 0; j < k; j++) {
+            kaxpy(y[j], v[j], u, nthreads);
+        }
+        precond(u, z);
+        kaxpy(1.0, z, x, nthreads);
+        if (history.back() <= tol) {
+            converged = true;
+            break;
+        }
+    }
+    finish(b, x, bnrm);
+}
+
+// ############ Preconditioners ############
+
+scilib::LinOp scilib::jacobi(MatDoub_I &a) {
+    Int i, n = a.nrows();
+    VecDoub dinv(n);
+    for (i = 0; i < n; i++) {
+        dinv[i] = (a[i][i] != 0.0 ? 1.0 / a[i][i] : 1.0);
+    }
+    return [dinv](VecDoub_I &x, VecDoub_O &y) {
+        for (Int i = 0; i < x.size(); i++) {
+            y[i] = dinv[i] * x[i];
+        }
+    };
+}
+
+scilib::LinOp scilib::jacobi(const SparseMat &a) {
+    Int i, p, n = a.nrows;
+    VecDoub dinv(n, 1.0);
+    for (i = 0; i < n; i++) {
+        for (p = a.row_ptr[i]; p < a.row_ptr[i + 1]; p++) {
+            if (a.col_ind[p] == i && a.val[p] != 0.0) {
+                dinv[i] = 1.0 / a.val[p];
+            }
+        }
+    }
+    return [dinv](VecDoub_I &x, VecDoub_O &y) {
+        for (Int i = 0; i < x.size(); i++) {
+            y[i] = dinv[i] * x[i];
+        }
+    };
+}
+
+// IKJ elimination restricted to the pattern of a; iw maps the columns of the
+// current row to their positions.
+scilib::ILU0::ILU0(const SparseMat &a) : n(a.nrows), lu(a), diag(n) {
+    Int i, j, k, p, q;
+    VecInt iw(n, -1);
+    for (i = 0; i < n; i++) {
+        for (p = lu.row_ptr[i]; p < lu.row_ptr[i + 1]; p++) {
+            iw[lu.col_ind[p]] = p;
+        }
+        if (iw[i] == -1) {
+            throw("ILU0: missing diagonal");
+        }
+        for (p = lu.row_ptr[i]; p < lu.row_ptr[i + 1] && (k = lu.col_ind[p]) < i; p++) {
+            lu.val[p] /= lu.val[diag[k]];
+            for (q = diag[k] + 1; q < lu.row_ptr[k + 1]; q++) {
+                j = iw[lu.col_ind[q]];
+                if (j != -1) {
+                    lu.val[j] -= lu.val[p] * lu.val[q];
+                }
+            }
+        }
+        diag[i] = iw[i];
+        if (lu.val[diag[i]] == 0.0) {
+            throw("ILU0: zero pivot");
+        }
+        for (p = lu.row_ptr[i]; p < lu.row_ptr[i + 1]; p++) {
+            iw[lu.col_ind[p]] = -1;
+        }
+    }
+}
+
+void scilib::ILU0::solve(VecDoub_I &b, VecDoub_O &x) {
+    Int i, p;
+    Doub sum;
+    for (i = 0; i < n; i++) {
+        for (sum = b[i], p = lu.row_ptr[i]; p < diag[i]; p++) {
+            sum -= lu.val[p] * x[lu.col_ind[p]];
+        }
+        x[i] = sum;
+    }
+    for (i = n - 1; i >= 0; i--) {
+        for (sum = x[i], p = diag[i] + 1; p < lu.row_ptr[i + 1]; p++) {
+            sum -= lu.val[p] * x[lu.col_ind[p]];
+        }
+        x[i] = sum / lu.val[diag[i]];
+    }
+}
+
+scilib::LinOp scilib::ILU0::op() {
+    return [this](VecDoub_I &b, VecDoub_O &x) {
+        solve(b, x);
+    };
+}
+
+scilib::BlockJacobi::BlockJacobi(MatDoub_I &a, const Int bs) : n(a.nrows()), bs(MAX(bs, 1)) {
+    Int b, i, j, k0, sz;
+    nblocks = (n + this->bs - 1) / this->bs;
+    try {
+        for (b = 0; b < nblocks; b++) {
+            k0 = b * this->bs;
+            sz = MIN(this->bs, n - k0);
+            blocks.push_back(new MatDoub(sz, sz));
+            for (i = 0; i < sz; i++) {
+                for (j = 0; j < sz; j++) {
+                    (*blocks[b])[i][j] = a[k0 + i][k0 + j];
+                }
+            }
+            lu.push_back(new LUdcmp(*blocks[b]));
+        }
+    } catch (...) {
+        release(); // a singular block throws; free what was built so far
+        throw;
+    }
+}
+
+scilib::BlockJacobi::~BlockJacobi() {
+    release();
+}
+
+void scilib::BlockJacobi::release() {
+    for (Int b = 0; b < (Int)blocks.size(); b++) {
+        if (b < (Int)lu.size()) {
+            delete lu[b];
+        }
+        delete blocks[b];
+    }
+    lu.clear();
+    blocks.clear();
+}
+
+void scilib::BlockJacobi::solve(VecDoub_I &b, VecDoub_O &x) {
+    Int blk, i, k0, sz;
+    for (blk = 0; blk < nblocks; blk++) {
+        k0 = blk * bs;
+        sz = MIN(bs, n - k0);
+        VecDoub bb(sz), xx(sz);
+        for (i = 0; i < sz; i++) {
+            bb[i] = b[k0 + i];
+        }
+        lu[blk]->solve(bb, xx);
+        for (i = 0; i < sz; i++) {
+            x[k0 + i] = xx[i];
+        }
+    }
+}
+
+scilib::LinOp scilib::BlockJacobi::op() {
+    return [this](VecDoub_I &b, VecDoub_O &x) {
+        solve(b, x);
+    };
+}
@@ -1,34 +1,23 @@
 #include "../include/linalg.h"
 #include <assert.h>
 #include "../include/nr3.h"
+#include "../include/eft.h"
 
-// ############ LU Decomposition ############
+// ############ Blocked kernels ############
 
-scilib::LUdcmp::LUdcmp(MatDoub_I &a) : n(a.nrows()), lu(a), aref(a), indx(n) {
-    const Doub TINY = 1.0e-40;
-    Int i, j, k, imax;
+// Factor columns [k0, k0 + kb) of rows [k0, n) with scaled partial pivoting.
+// Row interchanges only touch the panel columns; lu_swap applies them to the
+// rest of the matrix afterwards.
+template <class T>
+static void lu_panel(NRmatrix<T> &lu, const Int k0, const Int kb, VecDoub &vv, VecInt &indx, Doub &d) {
+    const T TINY = 1.0e-40;
+    Int i, j, k, imax, n = lu.nrows(), kend = k0 + kb;
     Doub big, temp;
+    T tmp, piv;
 
-    VecDoub vv(n); // implicit scaling of each row
-    d = 1.0; // no row interchanges yet
-
-    // Compute scaling factors
-    for (i = 0; i < n; i++) {
+    for (k = k0; k < kend; k++) {
         big = 0.0;
-        for (j = 0; j < n; j++) {
-            if ((temp = abs(lu[i][j])) > big) {
-                big = temp;
-            }
-        }
-        if (big == 0.0) {
-            throw runtime_error("Cannot perform LU decomposition on singular matrix");
-        }
-        vv[i] = 1.0 / big;
-    }
-
-    // Main decomposition loop
-    for (k = 0; k < n; k++) {
-        big = 0.0; // to store largest element (pivot)
+        imax = k;
         for (i = k; i < n; i++) {
             temp = vv[i] * abs(lu[i][k]);
             if (temp > big) {
@@ -37,32 +26,197 @@ scilib::LUdcmp::LUdcmp(MatDoub_I &a) : n(a.nrows()), lu(a), aref(a), indx(n) {
             }
         }
 
-        // Pivoting
         if (k != imax) {
-            for (j = 0; j < n; j++) {
-                temp = lu[imax][j];
+            for (j = k0; j < kend; j++) {
+                tmp = lu[imax][j];
                 lu[imax][j] = lu[k][j];
-                lu[k][j] = temp;
+                lu[k][j] = tmp;
             }
-            d = -d; // Adjust the sign of the determinant
+            d = -d;
             vv[imax] = vv[k];
         }
         indx[k] = imax;
 
         if (lu[k][k] == 0.0) {
-            lu[k][k] = TINY; // Prevent division by zero
+            lu[k][k] = TINY;
         }
 
-        // Elimination
+        piv = lu[k][k];
         for (i = k + 1; i < n; i++) {
-            temp = lu[i][k] /= lu[k][k]; // Normalize the current element in L
-            for (j = k + 1; j < n; j++) {
-                lu[i][j] -= temp * lu[k][j]; // Update the remaining elements in U
+            T *lui = lu[i];
+            const T *luk = lu[k];
+            tmp = lui[k] /= piv;
+            for (j = k + 1; j < kend; j++) {
+                lui[j] -= tmp * luk[j];
+            }
+        }
+    }
+}
+
+// Apply the interchanges recorded for pivots [k0, kend) to columns [c0, c1).
+template <class T>
+static void lu_swap(NRmatrix<T> &lu, VecInt_I &indx, const Int k0, const Int kend, const Int c0, const Int c1) {
+    Int j, k, ip;
+    T tmp;
+    for (k = k0; k < kend; k++) {
+        ip = indx[k];
+        if (ip != k) {
+            T *a = lu[k], *b = lu[ip];
+            for (j = c0; j < c1; j++) {
+                tmp = a[j];
+                a[j] = b[j];
+                b[j] = tmp;
+            }
+        }
+    }
+}
+
+// U12 = L11^-1 A12 for the panel rows [k0, k0 + kb), columns [c0, c1).
+template <class T>
+static void lu_trsm(NRmatrix<T> &lu, const Int k0, const Int kb, const Int c0, const Int c1) {
+    Int i, j, p;
+    T tmp;
+    for (i = k0 + 1; i < k0 + kb; i++) {
+        T *lui = lu[i];
+        for (p = k0; p < i; p++) {
+            const T *lup = lu[p];
+            tmp = lui[p];
+            for (j = c0; j < c1; j++) {
+                lui[j] -= tmp * lup[j];
+            }
+        }
+    }
+}
+
+// A22 -= L21 U12 over rows [k0 + kb, n), columns [c0, c1). Columns are walked
+// in strips so the kb x LU_JB block of U12 stays resident in cache while every
+// trailing row streams past it. Each element sees its updates in the same order
+// as the unblocked elimination, so results match it exactly.
+static const Int LU_JB = 256;
+
+template <class T>
+static void lu_gemm(NRmatrix<T> &lu, const Int k0, const Int kb, const Int c0, const Int c1) {
+    Int i, j, p, jj, jend, n = lu.nrows(), kend = k0 + kb;
+    T t0, t1, t2, t3;
+    for (jj = c0; jj < c1; jj += LU_JB) {
+        jend = MIN(jj + LU_JB, c1);
+        for (i = kend; i < n; i++) {
+            T *lui = lu[i];
+            // four rank-1 updates per sweep over the strip, applied in order
+            for (p = k0; p + 3 < kend; p += 4) {
+                const T *u0 = lu[p], *u1 = lu[p + 1], *u2 = lu[p + 2], *u3 = lu[p + 3];
+                t0 = lui[p];
+                t1 = lui[p + 1];
+                t2 = lui[p + 2];
+                t3 = lui[p + 3];
+                for (j = jj; j < jend; j++) {
+                    lui[j] = lui[j] - t0 * u0[j] - t1 * u1[j] - t2 * u2[j] - t3 * u3[j];
+                }
+            }
+            for (; p < kend; p++) {
+                const T *u0 = lu[p];
+                t0 = lui[p];
+                for (j = jj; j < jend; j++) {
+                    lui[j] -= t0 * u0[j];
+                }
+            }
+        }
+    }
+}
+
+// Scaling factors for implicit pivoting; throws on an all-zero row.
+template <class T>
+static void lu_scale(const NRmatrix<T> &lu, VecDoub &vv) {
+    Int i, j, n = lu.nrows();
+    Doub big, temp;
+    for (i = 0; i < n; i++) {
+        big = 0.0;
+        for (j = 0; j < n; j++) {
+            if ((temp = abs(lu[i][j])) > big) {
+                big = temp;
             }
         }
+        if (big == 0.0) {
+            throw runtime_error("Cannot perform LU decomposition on singular matrix");
+        }
+        vv[i] = 1.0 / big;
     }
 }
 
+// Right-looking blocked factorization: factor a panel of nb columns, then push
+// its interchanges and L factor through the trailing matrix as a GEMM update.
+// nb >= n degenerates to the classic unblocked k-i-j elimination.
+//
+// With nthreads > 1 the matrix is split into column tiles of width nb and each
+// panel and tile update becomes an OpenMP task. A tile update only waits on
+// the panel it consumes and on the previous update of the same tile, so panel
+// s + 1 starts as soon as its own tile is updated and overlaps the rest of
+// step s. Interchanges left of each panel are deferred to a final sweep.
+template <class T>
+static void lu_factor(NRmatrix<T> &lu, VecInt &indx, Doub &d, Int nb, const Int nthreads) {
+    Int s, t, k0, kb, c0, c1, nt, n = lu.nrows();
+    VecDoub vv(n); // implicit scaling of each row
+
+    d = 1.0; // no row interchanges yet
+    lu_scale(lu, vv);
+    if (nb < 1) {
+        nb = 1;
+    }
+
+    if (nthreads <= 1 || n <= nb) {
+        for (k0 = 0; k0 < n; k0 += nb) {
+            kb = MIN(nb, n - k0);
+            lu_panel(lu, k0, kb, vv, indx, d);
+            lu_swap(lu, indx, k0, k0 + kb, 0, k0);
+            if (k0 + kb < n) {
+                lu_swap(lu, indx, k0, k0 + kb, k0 + kb, n);
+                lu_trsm(lu, k0, kb, k0 + kb, n);
+                lu_gemm(lu, k0, kb, k0 + kb, n);
+            }
+        }
+        return;
+    }
+
+    nt = (n + nb - 1) / nb;
+    VecChar dep(nt); // task dependency tokens, one per column tile
+    Char *tile = &dep[0];
+
+#pragma omp parallel num_threads(nthreads) private(s, t, k0, kb, c0, c1)
+    {
+#pragma omp single
+        for (s = 0; s < nt; s++) {
+            k0 = s * nb;
+            kb = MIN(nb, n - k0);
+#pragma omp task depend(inout: tile[s]) priority(1) shared(lu, vv, indx, d)
+            lu_panel(lu, k0, kb, vv, indx, d);
+
+            for (t = s + 1; t < nt; t++) {
+                c0 = t * nb;
+                c1 = MIN(c0 + nb, n);
+#pragma omp task depend(in: tile[s]) depend(inout: tile[t]) priority(t == s + 1 ? 1 : 0) shared(lu, indx)
+                {
+                    lu_swap(lu, indx, k0, k0 + kb, c0, c1);
+                    lu_trsm(lu, k0, kb, c0, c1);
+                    lu_gemm(lu, k0, kb, c0, c1);
+                }
+            }
+        }
+
+        // interchanges of later panels, applied tile by tile in pivot order
+#pragma omp for schedule(dynamic)
+        for (t = 0; t < nt - 1; t++) {
+            c0 = t * nb;
+            lu_swap(lu, indx, c0 + nb, n, c0, c0 + nb);
+        }
+    }
+}
+
+// ############ LU Decomposition ############
+
+scilib::LUdcmp::LUdcmp(MatDoub_I &a, Int nb, Int nthreads) : n(a.nrows()), lu(a), aref(a), indx(n), nthreads(nthreads) {
+    lu_factor(lu, indx, d, nb, nthreads);
+}
+
 void scilib::LUdcmp::solve(VecDoub_I &b, VecDoub_O &x) {
     Int i, ii = 0, ip, j;
     Doub sum;
@@ -95,32 +249,168 @@ void scilib::LUdcmp::solve(VecDoub_I &b, VecDoub_O &x) {
     }
 }
 
-// b: n x m
+// Forward and back substitution on columns [c0, c1) of x, in place. Rows are
+// updated as contiguous segments, so the inner loops run across right-hand
+// sides and vectorize.
+static const Int LU_RHS = 64;
+
+template <class T>
+static void lu_solve_block(const NRmatrix<T> &lu, VecInt_I &indx, NRmatrix<T> &x, const Int c0, const Int c1) {
+    Int i, j, c, ip, n = lu.nrows();
+    T tmp, piv;
+
+    for (i = 0; i < n; i++) {
+        ip = indx[i];
+        if (ip != i) {
+            T *xi = x[i], *xp = x[ip];
+            for (c = c0; c < c1; c++) {
+                tmp = xi[c];
+                xi[c] = xp[c];
+                xp[c] = tmp;
+            }
+        }
+    }
+    for (i = 1; i < n; i++) {
+        T *xi = x[i];
+        const T *lui = lu[i];
+        for (j = 0; j < i; j++) {
+            const T *xj = x[j];
+            tmp = lui[j];
+            for (c = c0; c < c1; c++) {
+                xi[c] -= tmp * xj[c];
+            }
+        }
+    }
+    for (i = n - 1; i >= 0; i--) {
+        T *xi = x[i];
+        const T *lui = lu[i];
+        for (j = i + 1; j < n; j++) {
+            const T *xj = x[j];
+            tmp = lui[j];
+            for (c = c0; c < c1; c++) {
+                xi[c] -= tmp * xj[c];
+            }
+        }
+        piv = lui[i];
+        for (c = c0; c < c1; c++) {
+            xi[c] /= piv;
+        }
+    }
+}
+
+// b: n x m, may alias x. Right-hand sides are solved in column blocks of
+// width LU_RHS (narrower when needed to keep every thread busy); each block
+// makes one pass over lu.
 void scilib::LUdcmp::solve(MatDoub_I &b, MatDoub_O &x) {
-    int i, j, m=b.ncols();
+    Int i, j, blk, nblk, width, m = b.ncols();
     if (b.nrows() != n || x.nrows() != n || b.ncols() != x.ncols()) {
         throw ("LUDcmp::Bad sizes");
     }
-    VecDoub xx(n);
-    for (j = 0; j < m; j++) {
-        for (i = 0; i < n; i++) {
-            xx[i] = b[i][j];
-        }
-        solve(xx, xx);
+    if (&b != &x) {
         for (i = 0; i < n; i++) {
-            x[i][j] = xx[i];
+            for (j = 0; j < m; j++) {
+                x[i][j] = b[i][j];
+            }
         }
     }
+
+    width = LU_RHS;
+    if (nthreads > 1) {
+        width = MIN(width, MAX(8, (m + nthreads - 1) / nthreads));
+    }
+    nblk = (m + width - 1) / width;
+
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1 && nblk > 1) schedule(dynamic)
+    for (blk = 0; blk < nblk; blk++) {
+        lu_solve_block(lu, indx, x, blk * width, MIN((blk + 1) * width, m));
+    }
 }
 
+// Inverse from the factors, A^-1 = U^-1 L^-1 P, in three sweeps that each cost
+// about a third of the factorization:
+//  1. U^-1 by back substitution on column blocks (blocks are independent
+//     because U is read from lu, not from ainv);
+//  2. X L = U^-1 solved row by row, each row block reusing a row of L;
+//  3. the interchanges applied to columns in reverse pivot order.
+static const Int LU_INV_ROWS = 32;
+
 void scilib::LUdcmp::inverse(MatDoub_O &ainv) {
-    Int i, j;
+    Int blk, nblk;
     ainv.resize(n, n);
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < n; j++) {
-            ainv[i][j] = 1.0;
+
+    nblk = (n + LU_RHS - 1) / LU_RHS;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1 && nblk > 1) schedule(dynamic)
+    for (blk = 0; blk < nblk; blk++) {
+        Int i, k, c, c0, c1;
+        Doub tmp, piv;
+        c0 = (nblk - 1 - blk) * LU_RHS; // widest blocks first
+        c1 = MIN(c0 + LU_RHS, n);
+        for (i = n - 1; i >= c1; i--) {
+            for (c = c0; c < c1; c++) {
+                ainv[i][c] = 0.0;
+            }
+        }
+        for (i = c1 - 1; i >= 0; i--) {
+            Doub *xi = ainv[i];
+            const Doub *lui = lu[i];
+            for (c = c0; c < c1; c++) {
+                xi[c] = (c == i ? 1.0 : 0.0);
+            }
+            for (k = i + 1; k < c1; k++) {
+                const Doub *xk = ainv[k];
+                tmp = lui[k];
+                for (c = MAX(c0, k); c < c1; c++) {
+                    xi[c] -= tmp * xk[c];
+                }
+            }
+            piv = lui[i];
+            for (c = MAX(c0, i); c < c1; c++) {
+                xi[c] /= piv;
+            }
+        }
+    }
+
+    nblk = (n + LU_INV_ROWS - 1) / LU_INV_ROWS;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1 && nblk > 1) schedule(dynamic)
+    for (blk = 0; blk < nblk; blk++) {
+        Int i, j, k, ip, r0, r1;
+        Doub tmp;
+        r0 = blk * LU_INV_ROWS;
+        r1 = MIN(r0 + LU_INV_ROWS, n);
+        // rows k..k-3 of L are applied together: finish the small triangle
+        // among x[k-3..k] first, then one sweep over the rest of the row
+        for (k = n - 1; k >= 4; k -= 4) {
+            const Doub *l0 = lu[k], *l1 = lu[k - 1], *l2 = lu[k - 2], *l3 = lu[k - 3];
+            for (i = r0; i < r1; i++) {
+                Doub *xi = ainv[i];
+                Doub t0, t1, t2, t3;
+                t0 = xi[k];
+                t1 = xi[k - 1] -= t0 * l0[k - 1];
+                t2 = xi[k - 2] -= t0 * l0[k - 2] + t1 * l1[k - 2];
+                t3 = xi[k - 3] -= t0 * l0[k - 3] + t1 * l1[k - 3] + t2 * l2[k - 3];
+                for (j = 0; j < k - 3; j++) {
+                    xi[j] -= t0 * l0[j] + t1 * l1[j] + t2 * l2[j] + t3 * l3[j];
+                }
+            }
+        }
+        for (; k > 0; k--) {
+            const Doub *luk = lu[k];
+            for (i = r0; i < r1; i++) {
+                Doub *xi = ainv[i];
+                tmp = xi[k];
+                for (j = 0; j < k; j++) {
+                    xi[j] -= tmp * luk[j];
+                }
+            }
+        }
+        for (k = n - 1; k >= 0; k--) {
+            ip = indx[k];
+            if (ip != k) {
+                for (i = r0; i < r1; i++) {
+                    SWAP(ainv[i][k], ainv[i][ip]);
+                }
+            }
         }
-        solve(ainv, ainv);
     }
 }
 
@@ -132,18 +422,189 @@ Doub scilib::LUdcmp::det() {
     return dd;
 }
 
+// One step of iterative improvement. The residual is accumulated with
+// error-free transformations (see eft.h), which is at least as accurate as
+// the long double sum it replaces and vectorizes.
 void scilib::LUdcmp::mprove(VecDoub_I &b, VecDoub_IO &x) {
-    Int i, j;
+    Int i;
     VecDoub r(n);
+    residual2(aref, x, b, r, nthreads);
+    solve(r, r);
     for (i = 0; i < n; i++) {
-        Ldoub sdp = -b[ i];
-        for (j = 0; j < n; j++) {
-            sdp += (Ldoub) aref[i][j] * (Ldoub)x[j];
+        x[i] += r[i];
+    }
+}
+
+// ############ Mixed-Precision LU ############
+
+// Forward and back substitution on a single vector, in place.
+template <class T>
+static void lu_solve_vec(const NRmatrix<T> &lu, VecInt_I &indx, NRvector<T> &x) {
+    Int i, j, ip, n = lu.nrows();
+    T sum;
+    for (i = 0; i < n; i++) {
+        ip = indx[i];
+        sum = x[ip];
+        x[ip] = x[i];
+        for (j = 0; j < i; j++) {
+            sum -= lu[i][j] * x[j];
         }
-        r[i] = sdp;
+        x[i] = sum;
     }
-    solve(r, r);
+    for (i = n - 1; i >= 0; i--) {
+        sum = x[i];
+        for (j = i + 1; j < n; j++) {
+            sum -= lu[i][j] * x[j];
+        }
+        x[i] = sum / lu[i][i];
+    }
+}
+
+// The float factorization is refined in double for at most MP_MAXITS steps,
+// stopping once ||r|| <= ||x|| ||A|| eps sqrt(n) (the dsgesv criterion).
+static const Int MP_MAXITS = 30;
+
+scilib::MixedLUdcmp::MixedLUdcmp(MatDoub_I &a, Int nb, Int nthreads) : n(a.nrows()), lu(n, n), indx(n), nb(nb), nthreads(nthreads), its(0), full(NULL), aref(a) {
+    Int i, j;
+    Doub sum, amax = 0.0, pivtol;
+    anorm = 0.0;
+    for (i = 0; i < n; i++) {
+        for (sum = 0.0, j = 0; j < n; j++) {
+            sum += abs(a[i][j]);
+            amax = MAX(amax, abs(a[i][j]));
+            lu[i][j] = (float)a[i][j];
+        }
+        anorm = MAX(anorm, sum);
+    }
+    lu_factor(lu, indx, d, nb, nthreads);
+
+    // overflow or a vanishing pivot in single precision: go straight to double.
+    // lu_panel replaces exact zeros by TINY, so compare against n eps max|a|,
+    // below which a float pivot is rounding noise.
+    pivtol = MAX(n * amax * numeric_limits<float>::epsilon(), Doub(numeric_limits<float>::min()));
     for (i = 0; i < n; i++) {
-        x[i] -= r[i];
+        if (!std::isfinite(lu[i][i]) || abs(lu[i][i]) <= pivtol) {
+            full = new LUdcmp(aref, nb, nthreads);
+            break;
+        }
     }
-}
\ No newline at end of file
+}
+
+scilib::MixedLUdcmp::~MixedLUdcmp() {
+    delete full;
+}
+
+// b may alias x.
+void scilib::MixedLUdcmp::solve(VecDoub_I &b, VecDoub_O &x) {
+    Int i;
+    Doub rnorm, xnorm, cte = anorm * numeric_limits<Doub>::epsilon() * sqrt(Doub(n));
+    if (b.size() != n || x.size() != n) {
+        throw("MixedLUdcmp: bad sizes in solve");
+    }
+    if (full) {
+        its = -1;
+        full->solve(b, x);
+        return;
+    }
+
+    NRvector<float> xs(n);
+    VecDoub bb(b), r(n);
+    for (i = 0; i < n; i++) {
+        xs[i] = (float)bb[i];
+    }
+    lu_solve_vec(lu, indx, xs);
+    for (i = 0; i < n; i++) {
+        x[i] = xs[i];
+    }
+
+    for (its = 0; its < MP_MAXITS; its++) {
+        residual2(aref, x, bb, r, nthreads);
+        rnorm = xnorm = 0.0;
+        for (i = 0; i < n; i++) {
+            rnorm = MAX(rnorm, abs(r[i]));
+            xnorm = MAX(xnorm, abs(x[i]));
+        }
+        if (rnorm <= xnorm * cte) {
+            return;
+        }
+        for (i = 0; i < n; i++) {
+            xs[i] = (float)r[i];
+        }
+        lu_solve_vec(lu, indx, xs);
+        for (i = 0; i < n; i++) {
+            x[i] += xs[i];
+        }
+    }
+
+    // refinement stalled: the matrix is too ill-conditioned for single precision
+    its = -1;
+    full = new LUdcmp(aref, nb, nthreads);
+    full->solve(bb, x);
+}
+
+// b: n x m, may alias x. All columns are refined together and the loop runs
+// until every column meets the criterion.
+void scilib::MixedLUdcmp::solve(MatDoub_I &b, MatDoub_O &x) {
+    Int i, c, blk, nblk, m = b.ncols();
+    Doub cte = anorm * numeric_limits<Doub>::epsilon() * sqrt(Doub(n));
+    Bool done;
+    if (b.nrows() != n || x.nrows() != n || b.ncols() != x.ncols()) {
+        throw("MixedLUdcmp: bad sizes in solve");
+    }
+    if (full) {
+        its = -1;
+        full->solve(b, x);
+        return;
+    }
+
+    MatDoub bb(b), r(n, m);
+    NRmatrix<float> xs(n, m);
+    VecDoub rnorm(m), xnorm(m);
+    nblk = (m + LU_RHS - 1) / LU_RHS;
+    for (i = 0; i < n; i++) {
+        for (c = 0; c < m; c++) {
+            xs[i][c] = (float)bb[i][c];
+            x[i][c] = 0.0;
+        }
+    }
+
+    for (its = 0; ; its++) {
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1 && nblk > 1) schedule(dynamic)
+        for (blk = 0; blk < nblk; blk++) {
+            lu_solve_block(lu, indx, xs, blk * LU_RHS, MIN((blk + 1) * LU_RHS, m));
+        }
+        for (c = 0; c < m; c++) {
+            rnorm[c] = xnorm[c] = 0.0;
+        }
+        for (i = 0; i < n; i++) {
+            for (c = 0; c < m; c++) {
+                x[i][c] += xs[i][c];
+            }
+        }
+        residual2(aref, x, bb, r, nthreads); // same residual as the vector solve
+        for (i = 0; i < n; i++) {
+            for (c = 0; c < m; c++) {
+                rnorm[c] = MAX(rnorm[c], abs(r[i][c]));
+                xnorm[c] = MAX(xnorm[c], abs(x[i][c]));
+            }
+        }
+        for (done = true, c = 0; c < m; c++) {
+            done = done && rnorm[c] <= xnorm[c] * cte;
+        }
+        if (done) {
+            return;
+        }
+        if (its == MP_MAXITS) {
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            for (c = 0; c < m; c++) {
+                xs[i][c] = (float)r[i][c];
+            }
+        }
+    }
+
+    its = -1;
+    full = new LUdcmp(aref, nb, nthreads);
+    full->solve(bb, x);
+}
@@ -0,0 +1,87 @@
+#include "../include/linalg.h"
+
+// ############ Dense Matrix Products ############
+
+static const Int MM_KB = 256; // rows of b kept in cache by matmul
+static const Int MM_LB = 64; // rows of c per task in matmul_tn
+
+// c = a b. Rows of c are shared across threads; within a row the update is
+// an axpy over rows of b, four at a time, with b swept in panels of MM_KB
+// rows so that a panel stays in cache while every row of c passes over it.
+void scilib::matmul(MatDoub_I &a, MatDoub_I &b, MatDoub_O &c, const Int nthreads) {
+    Int i, j, l, l0, l1, m = a.nrows(), p = a.ncols(), k = b.ncols();
+    Doub t0, t1, t2, t3;
+    if (b.nrows() != p) {
+        throw("matmul: bad sizes");
+    }
+    c.assign(m, k, 0.0);
+    for (l0 = 0; l0 < p; l0 += MM_KB) {
+        l1 = MIN(l0 + MM_KB, p);
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(j, l, t0, t1, t2, t3) schedule(static)
+        for (i = 0; i < m; i++) {
+            const Doub *ai = a[i];
+            Doub *ci = c[i];
+            for (l = l0; l + 3 < l1; l += 4) {
+                const Doub *b0 = b[l], *b1 = b[l + 1], *b2 = b[l + 2], *b3 = b[l + 3];
+                t0 = ai[l];
+                t1 = ai[l + 1];
+                t2 = ai[l + 2];
+                t3 = ai[l + 3];
+#pragma omp simd
+                for (j = 0; j < k; j++) {
+                    ci[j] += t0 * b0[j] + t1 * b1[j] + t2 * b2[j] + t3 * b3[j];
+                }
+            }
+            for (; l < l1; l++) {
+                const Doub *b0 = b[l];
+                t0 = ai[l];
+#pragma omp simd
+                for (j = 0; j < k; j++) {
+                    ci[j] += t0 * b0[j];
+                }
+            }
+        }
+    }
+}
+
+// c = a^T b without forming a^T. Each task owns MM_LB rows of c and
+// accumulates the outer products of the matching slice of row i of a with
+// row i of b, four rows at a time, so the task's block of c stays in cache.
+void scilib::matmul_tn(MatDoub_I &a, MatDoub_I &b, MatDoub_O &c, const Int nthreads) {
+    Int i, j, l, lb, m = a.nrows(), p = a.ncols(), k = b.ncols(), nlb = (p + MM_LB - 1) / MM_LB;
+    Doub t0, t1, t2, t3;
+    if (b.nrows() != m) {
+        throw("matmul_tn: bad sizes");
+    }
+    c.assign(p, k, 0.0);
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(i, j, l, t0, t1, t2, t3) schedule(static)
+    for (lb = 0; lb < nlb; lb++) {
+        Int l0 = lb * MM_LB, l1 = MIN(l0 + MM_LB, p);
+        for (i = 0; i + 3 < m; i += 4) {
+            const Doub *a0 = a[i], *a1 = a[i + 1], *a2 = a[i + 2], *a3 = a[i + 3];
+            const Doub *b0 = b[i], *b1 = b[i + 1], *b2 = b[i + 2], *b3 = b[i + 3];
+            for (l = l0; l < l1; l++) {
+                Doub *cl = c[l];
+                t0 = a0[l];
+                t1 = a1[l];
+                t2 = a2[l];
+                t3 = a3[l];
+#pragma omp simd
+                for (j = 0; j < k; j++) {
+                    cl[j] += t0 * b0[j] + t1 * b1[j] + t2 * b2[j] + t3 * b3[j];
+                }
+            }
+        }
+        for (; i < m; i++) {
+            const Doub *a0 = a[i], *b0 = b[i];
+            for (l = l0; l < l1; l++) {
+                Doub *cl = c[l];
+                t0 = a0[l];
+#pragma omp simd
+                for (j = 0; j < k; j++) {
+                    cl[j] += t0 * b0[j];
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,273 @@
+#include "../include/linalg.h"
+
+// ############ Column-Pivoted QR ############
+
+// Householder vector for x = a[k .. m-1][k]: on exit a[k][k] = beta, the rest
+// of v below it (v[k] = 1) and tau, with (I - tau v v^T) x = beta e_0.
+static Doub qrp_reflector(MatDoub &a, const Int k) {
+    Int i, m = a.nrows();
+    Doub alpha = a[k][k], scale = 0.0, sum = 0.0, beta, tau, f;
+    for (i = k + 1; i < m; i++) {
+        scale = MAX(scale, abs(a[i][k]));
+    }
+    if (scale == 0.0) {
+        return 0.0;
+    }
+    scale = MAX(scale, abs(alpha));
+    for (i = k + 1; i < m; i++) {
+        sum += SQR(a[i][k] / scale);
+    }
+    beta = -SIGN(scale * sqrt(SQR(alpha / scale) + sum), alpha);
+    tau = (beta - alpha) / beta;
+    f = 1.0 / (alpha - beta);
+    for (i = k + 1; i < m; i++) {
+        a[i][k] *= f;
+    }
+    a[k][k] = beta;
+    return tau;
+}
+
+// Blocked QP3 (Quintana-Orti, Sun and Bischof). Within a block, the pending
+// Householder updates are held in F, with the trailing matrix equal to
+// A - V F^T; only the pivot column and the pivot row are brought up to date
+// at each step, which is all the next pivot choice needs. The column norms are
+// downdated from the pivot row; when cancellation makes a downdated norm
+// unreliable the block ends early and that norm is recomputed after the
+// trailing update.
+scilib::QRPdcmp::QRPdcmp(MatDoub_I &a, Int nb, Int nthreads) : m(a.nrows()), n(a.ncols()), qr(a), tau(MIN(m, n), 0.0), perm(n), nthreads(nthreads) {
+    Int i, j, k, p, q, kb, rk, pvt, kmax = MIN(m, n);
+    Bool recompute;
+    Doub akk, tmp, temp2, sum, t1, t2, t3;
+    const Doub tol3z = sqrt(numeric_limits<Doub>::epsilon());
+    eps = numeric_limits<Doub>::epsilon();
+    if (nb < 1) {
+        nb = 1;
+    }
+    nb = MIN(nb, MAX(kmax, 1));
+    VecDoub vn1(n, 0.0), vn2(n), auxv(nb);
+    VecBool stale(n, false);
+    MatDoub ft(nb, n); // F^T, row p for reflector k + p
+
+    for (i = 0; i < m; i++) {
+        const Doub *ai = qr[i];
+        for (j = 0; j < n; j++) {
+            vn1[j] += SQR(ai[j]);
+        }
+    }
+    for (j = 0; j < n; j++) {
+        perm[j] = j;
+        vn2[j] = vn1[j] = sqrt(vn1[j]);
+    }
+
+    for (k = 0; k < kmax; k += kb) {
+        recompute = false;
+        for (p = 0; p < MIN(nb, kmax - k) && !recompute; p++) {
+            rk = k + p;
+            for (pvt = rk, j = rk + 1; j < n; j++) {
+                if (vn1[j] > vn1[pvt]) {
+                    pvt = j;
+                }
+            }
+            if (pvt != rk) {
+                for (i = 0; i < m; i++) {
+                    SWAP(qr[i][pvt], qr[i][rk]);
+                }
+                for (q = 0; q < p; q++) {
+                    SWAP(ft[q][pvt], ft[q][rk]);
+                }
+                SWAP(perm[pvt], perm[rk]);
+                vn1[pvt] = vn1[rk];
+                vn2[pvt] = vn2[rk];
+            }
+
+            // bring column rk up to date and reduce it
+            for (i = rk; i < m; i++) {
+                for (sum = 0.0, q = 0; q < p; q++) {
+                    sum += qr[i][k + q] * ft[q][rk];
+                }
+                qr[i][rk] -= sum;
+            }
+            tau[rk] = (rk < m - 1 ? qrp_reflector(qr, rk) : 0.0);
+            akk = qr[rk][rk];
+            qr[rk][rk] = 1.0;
+
+            // F(:, p) = tau A^T v - tau F V^T v, as a row of ft
+            for (j = 0; j < n; j++) {
+                ft[p][j] = 0.0;
+            }
+            if (tau[rk] != 0.0) {
+                for (i = rk; i < m; i++) {
+                    const Doub *ai = qr[i];
+                    tmp = ai[rk];
+                    for (j = rk + 1; j < n; j++) {
+                        ft[p][j] += tmp * ai[j];
+                    }
+                }
+                for (q = 0; q < p; q++) {
+                    auxv[q] = 0.0;
+                }
+                for (i = rk; i < m; i++) {
+                    const Doub *ai = qr[i];
+                    tmp = ai[rk];
+                    for (q = 0; q < p; q++) {
+                        auxv[q] += ai[k + q] * tmp;
+                    }
+                }
+                for (q = 0; q < p; q++) {
+                    auxv[q] *= -tau[rk];
+                }
+                for (j = rk + 1; j < n; j++) {
+                    ft[p][j] *= tau[rk];
+                }
+                for (q = 0; q < p; q++) {
+                    tmp = auxv[q];
+                    for (j = rk + 1; j < n; j++) {
+                        ft[p][j] += tmp * ft[q][j];
+                    }
+                }
+            }
+
+            // bring row rk up to date
+            for (q = 0; q <= p; q++) {
+                tmp = qr[rk][k + q];
+                for (j = rk + 1; j < n; j++) {
+                    qr[rk][j] -= tmp * ft[q][j];
+                }
+            }
+            qr[rk][rk] = akk;
+
+            for (j = rk + 1; j < n; j++) {
+                if (vn1[j] != 0.0) {
+                    tmp = 1.0 - SQR(abs(qr[rk][j]) / vn1[j]);
+                    tmp = MAX(tmp, 0.0);
+                    temp2 = tmp * SQR(vn1[j] / vn2[j]);
+                    if (temp2 <= tol3z) {
+                        stale[j] = true;
+                        recompute = true;
+                    } else {
+                        vn1[j] *= sqrt(tmp);
+                    }
+                }
+            }
+        }
+        kb = p;
+
+        // trailing update A22 -= V2 F2^T, rows shared across threads
+        rk = k + kb;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(j, q, tmp, t1, t2, t3) schedule(static)
+        for (i = rk; i < m; i++) {
+            Doub *ai = qr[i];
+            for (q = 0; q + 3 < kb; q += 4) {
+                const Doub *f0 = ft[q], *f1 = ft[q + 1], *f2 = ft[q + 2], *f3 = ft[q + 3];
+                tmp = ai[k + q];
+                t1 = ai[k + q + 1];
+                t2 = ai[k + q + 2];
+                t3 = ai[k + q + 3];
+                for (j = rk; j < n; j++) {
+                    ai[j] -= tmp * f0[j] + t1 * f1[j] + t2 * f2[j] + t3 * f3[j];
+                }
+            }
+            for (; q < kb; q++) {
+                const Doub *f0 = ft[q];
+                tmp = ai[k + q];
+                for (j = rk; j < n; j++) {
+                    ai[j] -= tmp * f0[j];
+                }
+            }
+        }
+
+        for (j = rk; j < n; j++) {
+            if (stale[j]) {
+                for (sum = 0.0, i = rk; i < m; i++) {
+                    sum += SQR(qr[i][j]);
+                }
+                vn2[j] = vn1[j] = sqrt(sum);
+                stale[j] = false;
+            }
+        }
+    }
+}
+
+// Numerical rank: diagonal entries of R above thresh, by default the SVD
+// threshold with |r[0][0]| standing in for the largest singular value.
+Int scilib::QRPdcmp::rank(Doub thresh) {
+    Int k, nr = 0;
+    tsh = (thresh >= 0. ? thresh : 0.5 * sqrt(m + n + 1.) * (MIN(m, n) > 0 ? abs(qr[0][0]) : 0.0) * eps);
+    for (k = 0; k < MIN(m, n); k++) {
+        if (abs(qr[k][k]) > tsh) {
+            nr++;
+        }
+    }
+    return nr;
+}
+
+// The first rank columns of Q
+MatDoub scilib::QRPdcmp::range(Doub thresh) {
+    Int i, j, nr = rank(thresh);
+    MatDoub range(m, nr);
+    VecDoub e(m);
+    for (j = 0; j < nr; j++) {
+        for (i = 0; i < m; i++) {
+            e[i] = (i == j ? 1.0 : 0.0);
+        }
+        householder_qmult(qr, tau, e);
+        for (i = 0; i < m; i++) {
+            range[i][j] = e[i];
+        }
+    }
+    return range;
+}
+
+// Orthonormal basis for the columns of P [-R11^-1 R12; I]
+MatDoub scilib::QRPdcmp::nullspace(Doub thresh) {
+    Int i, j, l, nr = rank(thresh), nn = n - nr;
+    Doub sum;
+    MatDoub z(n, nn), basis(n, nn);
+    for (j = 0; j < nn; j++) {
+        for (i = nr - 1; i >= 0; i--) {
+            for (sum = -qr[i][nr + j], l = i + 1; l < nr; l++) {
+                sum -= qr[i][l] * z[perm[l]][j];
+            }
+            z[perm[i]][j] = sum / qr[i][i];
+        }
+        for (i = nr; i < n; i++) {
+            z[perm[i]][j] = (i == nr + j ? 1.0 : 0.0);
+        }
+    }
+    if (nn == 0) {
+        return basis;
+    }
+    VecDoub ztau, e(n);
+    householder_qr(z, ztau);
+    for (j = 0; j < nn; j++) {
+        for (i = 0; i < n; i++) {
+            e[i] = (i == j ? 1.0 : 0.0);
+        }
+        householder_qmult(z, ztau, e);
+        for (i = 0; i < n; i++) {
+            basis[i][j] = e[i];
+        }
+    }
+    return basis;
+}
+
+// Basic least-squares solution: x[perm[k]] = 0 beyond the numerical rank
+void scilib::QRPdcmp::solve(VecDoub_I &b, VecDoub_O &x, Doub thresh) {
+    Int i, j, nr = rank(thresh);
+    Doub sum;
+    if (b.size() != m) {
+        throw("QRPdcmp: bad sizes in solve");
+    }
+    VecDoub c(b), y(n, 0.0);
+    householder_qtmult(qr, tau, c);
+    for (i = nr - 1; i >= 0; i--) {
+        for (sum = c[i], j = i + 1; j < nr; j++) {
+            sum -= qr[i][j] * y[j];
+        }
+        y[i] = sum / qr[i][i];
+    }
+    x.resize(n);
+    for (i = 0; i < n; i++) {
+        x[perm[i]] = y[i];
+    }
+}
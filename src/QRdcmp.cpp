@@ -1,108 +1,455 @@
 #include "../include/linalg.h"
 
-scilib::QRdcmp::QRdcmp(MatDoub_I &a) : n(a.nrows()), qt(n, n), r(a), sing(false) {
-    Int i, j, k;
-    VecDoub c(n), d(n);
-    Doub scale, sigma, sum, tau;
+// ############ Blocked kernels ############
 
-    for (k = 0; k < n - 1; k++) {
+// Reflector k is Q_k = I - tau[k] v v^T, with v[k] = 1 implied and the rest
+// of v stored below the diagonal in column k of r. A block of kb reflectors is
+// applied at once in compact WY form, Q_k0 ... Q_(k0+kb-1) = I - V T V^T, so
+// the trailing update becomes two matrix-matrix products instead of kb rank-1
+// sweeps.
+static const Int QR_JB = 128;
+
+// Unblocked Householder QR of the panel rows [k0, n), columns [k0, k0 + kb).
+// Reflector k is applied to the later panel columns a row at a time, and the
+// diagonal of R replaces v[k].
+static void qr_panel(MatDoub &r, const Int k0, const Int kb, VecDoub &tau, Bool &sing, VecDoub &s) {
+    Int i, j, k, n = r.nrows(), kend = k0 + kb;
+    Doub scale, sigma, sum, tmp, ukk;
+    for (k = k0; k < kend; k++) {
+        tau[k] = 0.0;
+        if (k == n - 1) {
+            if (r[k][k] == 0.0) {
+                sing = true;
+            }
+            break;
+        }
         scale = 0.0;
         for (i = k; i < n; i++) {
             scale = MAX(scale, abs(r[i][k]));
-            if (scale = 0.0) {
-                sing = true;
-                c[k] = d[k] = 0.0;
-            } else {
-                for (i = k; i < n; i++) {
-                    r[i][k] /=  scale;
-                }
-                for (sum = 0.0, i=k; i < n; i++) {
-                    sum += SQR(r[i][k]);
-                }
-                sigma = SIGN(sqrt(sum), r[k][k]);
-                r[k][k] += sigma;
-                c[k] = sigma * r[k][k];
-                d[k] = -scale * sigma;
-                for (j = k + 1; j < n; j++) {
-                    for (sum = 0.0, i = k; i < n; i++) {
-                        sum += r[i][k] * r[i][j];
-                    }
-                    tau = sum / c[k];
-                    for (i = k; i < n; i++) {
-                        r[i][j] -= tau * r[i][k];
-                    }
-                }
+        }
+        if (scale == 0.0) {
+            sing = true;
+            continue;
+        }
+        for (sum = 0.0, i = k; i < n; i++) {
+            r[i][k] /= scale;
+            sum += SQR(r[i][k]);
+        }
+        sigma = SIGN(sqrt(sum), r[k][k]);
+        ukk = r[k][k] + sigma;
+        tau[k] = ukk / sigma;
+        for (i = k + 1; i < n; i++) {
+            r[i][k] /= ukk;
+        }
+        r[k][k] = -scale * sigma;
+
+        for (j = k + 1; j < kend; j++) {
+            s[j] = r[k][j];
+        }
+        for (i = k + 1; i < n; i++) {
+            const Doub *ri = r[i];
+            tmp = ri[k];
+            for (j = k + 1; j < kend; j++) {
+                s[j] += tmp * ri[j];
+            }
+        }
+        for (j = k + 1; j < kend; j++) {
+            s[j] *= tau[k];
+            r[k][j] -= s[j];
+        }
+        for (i = k + 1; i < n; i++) {
+            Doub *ri = r[i];
+            tmp = ri[k];
+            for (j = k + 1; j < kend; j++) {
+                ri[j] -= tmp * s[j];
             }
         }
     }
-    d[n - 1] = r[n-1][n-1];
-    if (d[n-1] == 0.0) {
-        sing = true;
+}
+
+// Copy the reflectors of the block into the zero-padded columns of v and build
+// the upper-triangular T with I - V T V^T = Q_k0 ... Q_(k0+kb-1).
+static void qr_larft(MatDoub_I &r, VecDoub_I &tau, const Int k0, const Int kb, MatDoub &v, MatDoub &t) {
+    Int i, p, q, n = r.nrows();
+    Doub sum;
+    for (i = k0; i < n; i++) {
+        for (p = 0; p < kb; p++) {
+            v[i][p] = (i > k0 + p ? r[i][k0 + p] : (i == k0 + p ? 1.0 : 0.0));
+        }
     }
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < n; j++) {
-            qt[i][j] = 0.0;
+    VecDoub z(kb);
+    for (p = 0; p < kb; p++) {
+        for (q = 0; q < p; q++) {
+            z[q] = 0.0;
         }
-        qt[i][i] = 1.0;
+        for (i = k0 + p; i < n; i++) {
+            const Doub *vi = v[i];
+            for (q = 0; q < p; q++) {
+                z[q] += vi[q] * vi[p];
+            }
+        }
+        for (q = 0; q < p; q++) {
+            for (sum = 0.0, i = q; i < p; i++) {
+                sum += t[q][i] * z[i];
+            }
+            t[q][p] = -tau[k0 + p] * sum;
+        }
+        for (q = p + 1; q < kb; q++) {
+            t[q][p] = 0.0;
+        }
+        t[p][p] = tau[k0 + p];
     }
-    for (k = 0; k < n - 1; k++) {
-        if (c[k] != 0.0) {
-            for (j = 0; j < n; j++) {
-                sum = 0.0;
-                for (i = k; i < n; i++) {
-                    sum += r[i][k] * qt[i][j];
+}
+
+// Apply I - V T^T V^T (trans, i.e. Q^T) or I - V T V^T to rows [k0, n),
+// columns [c0, c1) of a. w is kb x a.ncols() scratch indexed by column, so
+// disjoint column ranges can be updated concurrently.
+static void qr_larfb(MatDoub &a, MatDoub_I &v, MatDoub_I &t, const Int k0, const Int kb, const Int c0, const Int c1, const Bool trans, MatDoub &w) {
+    Int i, j, p, q, n = a.nrows();
+    Doub t0, t1, t2, t3;
+    for (p = 0; p < kb; p++) {
+        for (j = c0; j < c1; j++) {
+            w[p][j] = 0.0;
+        }
+    }
+    // W = V^T A, four rows of A per sweep
+    for (i = k0; i + 3 < n; i += 4) {
+        const Doub *a0 = a[i], *a1 = a[i + 1], *a2 = a[i + 2], *a3 = a[i + 3];
+        for (p = 0; p < kb; p++) {
+            Doub *wp = w[p];
+            t0 = v[i][p];
+            t1 = v[i + 1][p];
+            t2 = v[i + 2][p];
+            t3 = v[i + 3][p];
+            for (j = c0; j < c1; j++) {
+                wp[j] += t0 * a0[j] + t1 * a1[j] + t2 * a2[j] + t3 * a3[j];
+            }
+        }
+    }
+    for (; i < n; i++) {
+        const Doub *ai = a[i], *vi = v[i];
+        for (p = 0; p < kb; p++) {
+            Doub *wp = w[p];
+            t0 = vi[p];
+            for (j = c0; j < c1; j++) {
+                wp[j] += t0 * ai[j];
+            }
+        }
+    }
+    // W = T^T W or T W, in place
+    if (trans) {
+        for (p = kb - 1; p >= 0; p--) {
+            Doub *wp = w[p];
+            t0 = t[p][p];
+            for (j = c0; j < c1; j++) {
+                wp[j] *= t0;
+            }
+            for (q = 0; q < p; q++) {
+                const Doub *wq = w[q];
+                t0 = t[q][p];
+                for (j = c0; j < c1; j++) {
+                    wp[j] += t0 * wq[j];
                 }
-                sum /= c[k];
-                for (i = k; i < n; i++) {
-                    qt[i][j] -= sum * r[i][k];
+            }
+        }
+    } else {
+        for (p = 0; p < kb; p++) {
+            Doub *wp = w[p];
+            t0 = t[p][p];
+            for (j = c0; j < c1; j++) {
+                wp[j] *= t0;
+            }
+            for (q = p + 1; q < kb; q++) {
+                const Doub *wq = w[q];
+                t0 = t[p][q];
+                for (j = c0; j < c1; j++) {
+                    wp[j] += t0 * wq[j];
                 }
             }
         }
     }
-    for (i = 0; i < n; i++) {
-        r[i][i] = d[i];
+    // A -= V W, four rows of W per sweep
+    for (i = k0; i < n; i++) {
+        Doub *ai = a[i];
+        const Doub *vi = v[i];
+        for (p = 0; p + 3 < kb; p += 4) {
+            const Doub *w0 = w[p], *w1 = w[p + 1], *w2 = w[p + 2], *w3 = w[p + 3];
+            t0 = vi[p];
+            t1 = vi[p + 1];
+            t2 = vi[p + 2];
+            t3 = vi[p + 3];
+            for (j = c0; j < c1; j++) {
+                ai[j] -= t0 * w0[j] + t1 * w1[j] + t2 * w2[j] + t3 * w3[j];
+            }
+        }
+        for (; p < kb; p++) {
+            const Doub *w0 = w[p];
+            t0 = vi[p];
+            for (j = c0; j < c1; j++) {
+                ai[j] -= t0 * w0[j];
+            }
+        }
+    }
+}
+
+// Apply the block transformation to columns [c0, c1) in strips of QR_JB shared
+// across threads.
+static void qr_apply(MatDoub &a, MatDoub_I &v, MatDoub_I &t, const Int k0, const Int kb, const Int c0, const Int c1, const Bool trans, MatDoub &w, const Int nthreads) {
+    Int s, ns = (c1 - c0 + QR_JB - 1) / QR_JB;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1 && ns > 1) schedule(dynamic)
+    for (s = 0; s < ns; s++) {
+        qr_larfb(a, v, t, k0, kb, c0 + s * QR_JB, MIN(c0 + (s + 1) * QR_JB, c1), trans, w);
+    }
+}
+
+// ############ Householder QR ############
+
+// Right-looking blocked Householder QR of the m x n matrix a: factor a panel
+// of nb columns, then apply its reflectors to the trailing columns in compact
+// WY form. nb >= n is the unblocked algorithm.
+Bool scilib::householder_qr(MatDoub &a, VecDoub_O &tau, Int nb, const Int nthreads) {
+    Int k0, kb, m = a.nrows(), n = a.ncols(), kmax = MIN(m, n);
+    Bool sing = false;
+    nb = MIN(MAX(nb, 1), MAX(kmax, 1));
+    tau.resize(kmax);
+    VecDoub s(n);
+    MatDoub v(m, nb), t(nb, nb), w(nb, n);
+
+    for (k0 = 0; k0 < kmax; k0 += nb) {
+        kb = MIN(nb, kmax - k0);
+        qr_panel(a, k0, kb, tau, sing, s);
+        if (k0 + kb < n) {
+            qr_larft(a, tau, k0, kb, v, t);
+            qr_apply(a, v, t, k0, kb, k0 + kb, n, true, w, nthreads);
+        }
+    }
+    return sing;
+}
+
+// b = Q^T b, one reflector at a time
+void scilib::householder_qtmult(MatDoub_I &a, VecDoub_I &tau, VecDoub_IO &b) {
+    Int i, k, m = a.nrows();
+    Doub sum;
+    for (k = 0; k < tau.size(); k++) {
+        if (tau[k] != 0.0) {
+            for (sum = b[k], i = k + 1; i < m; i++) {
+                sum += a[i][k] * b[i];
+            }
+            sum *= tau[k];
+            b[k] -= sum;
+            for (i = k + 1; i < m; i++) {
+                b[i] -= sum * a[i][k];
+            }
+        }
+    }
+}
+
+// b = Q b, the reflectors in reverse order
+void scilib::householder_qmult(MatDoub_I &a, VecDoub_I &tau, VecDoub_IO &b) {
+    Int i, k, m = a.nrows();
+    Doub sum;
+    for (k = tau.size() - 1; k >= 0; k--) {
+        if (tau[k] != 0.0) {
+            for (sum = b[k], i = k + 1; i < m; i++) {
+                sum += a[i][k] * b[i];
+            }
+            sum *= tau[k];
+            b[k] -= sum;
+            for (i = k + 1; i < m; i++) {
+                b[i] -= sum * a[i][k];
+            }
+        }
+    }
+}
+
+// c = Q^T c for an m x p matrix c, block by block in compact WY form
+void scilib::householder_qtmult(MatDoub_I &a, VecDoub_I &tau, MatDoub_IO &c, Int nb, const Int nthreads) {
+    Int k0, kb, m = a.nrows(), kmax = tau.size();
+    nb = MIN(MAX(nb, 1), MAX(kmax, 1));
+    if (c.nrows() != m) {
+        throw("householder_qtmult: bad sizes");
+    }
+    MatDoub v(m, nb), t(nb, nb), w(nb, c.ncols());
+    for (k0 = 0; k0 < kmax; k0 += nb) {
+        kb = MIN(nb, kmax - k0);
+        qr_larft(a, tau, k0, kb, v, t);
+        qr_apply(c, v, t, k0, kb, 0, c.ncols(), true, w, nthreads);
+    }
+}
+
+// c = Q c, the blocks in reverse order
+void scilib::householder_qmult(MatDoub_I &a, VecDoub_I &tau, MatDoub_IO &c, Int nb, const Int nthreads) {
+    Int k0, kb, m = a.nrows(), kmax = tau.size();
+    nb = MIN(MAX(nb, 1), MAX(kmax, 1));
+    if (c.nrows() != m) {
+        throw("householder_qmult: bad sizes");
+    }
+    MatDoub v(m, nb), t(nb, nb), w(nb, c.ncols());
+    for (k0 = ((kmax - 1) / nb) * nb; k0 >= 0; k0 -= nb) {
+        kb = MIN(nb, kmax - k0);
+        qr_larft(a, tau, k0, kb, v, t);
+        qr_apply(c, v, t, k0, kb, 0, c.ncols(), false, w, nthreads);
+    }
+}
+
+// ############ QR Decomposition ############
+
+scilib::QRdcmp::QRdcmp(MatDoub_I &a, Int nb, Int nthreads, Bool formq) : m(a.nrows()), n(a.ncols()), r(a), sing(false), implicitq(true), nb(MAX(nb, 1)), nthreads(nthreads) {
+    sing = householder_qr(r, tau, this->nb, nthreads);
+    if (m < n) {
+        sing = true; // R has no n x n triangle to solve with
+    }
+    if (formq) {
+        formqt();
+    }
+}
+
+// Q = Q_0 Q_1 ... is accumulated backwards from the identity one block at a
+// time, so each block only touches the columns it can change, and is then
+// transposed in place. The reflectors are dropped from r afterwards.
+void scilib::QRdcmp::formqt() {
+    Int i, j, k0, kb, kmax = tau.size(), bs = MIN(nb, MAX(kmax, 1));
+    Doub tmp;
+    if (!implicitq) {
+        return;
+    }
+    MatDoub v(m, bs), t(bs, bs), w(bs, m);
+    qt.resize(m, m);
+    for (i = 0; i < m; i++) {
+        for (j = 0; j < m; j++) {
+            qt[i][j] = 0.0;
+        }
+        qt[i][i] = 1.0;
+    }
+    for (k0 = ((kmax - 1) / bs) * bs; k0 >= 0; k0 -= bs) {
+        kb = MIN(bs, kmax - k0);
+        qr_larft(r, tau, k0, kb, v, t);
+        qr_apply(qt, v, t, k0, kb, k0, m, false, w, nthreads);
+    }
+    for (i = 0; i < m; i++) {
         for (j = 0; j < i; j++) {
+            tmp = qt[i][j];
+            qt[i][j] = qt[j][i];
+            qt[j][i] = tmp;
+        }
+        for (j = 0; j < MIN(i, n); j++) {
             r[i][j] = 0.0;
         }
     }
+    implicitq = false;
 }
 
+// Least-squares solution when m > n
 void scilib::QRdcmp::solve(VecDoub_I &b, VecDoub_O &x) {
-    qtmult(b, x);
-    rsolve(x, x);
+    VecDoub c(m);
+    qtmult(b, c);
+    rsolve(c, x);
 }
 
 void scilib::QRdcmp::qtmult(VecDoub_I &b, VecDoub_O &x) {
     Int i, j;
     Doub sum;
-    for (i = 0; i < n; i++) {
-        sum = 0.;
-        for (j = 0; j < n; j++) {
-            sum += qt[i][j] * b[j];
+    if (!implicitq) {
+        VecDoub y(m);
+        for (i = 0; i < m; i++) {
+            sum = 0.;
+            for (j = 0; j < m; j++) {
+                sum += qt[i][j] * b[j];
+            }
+            y[i] = sum;
+        }
+        x = y;
+        return;
+    }
+    x = b;
+    householder_qtmult(r, tau, x);
+}
+
+void scilib::QRdcmp::qmult(VecDoub_I &b, VecDoub_O &x) {
+    Int i, j;
+    if (!implicitq) {
+        VecDoub y(m, 0.0);
+        for (j = 0; j < m; j++) {
+            for (i = 0; i < m; i++) {
+                y[i] += qt[j][i] * b[j];
+            }
         }
-        x[i] = sum;
+        x = y;
+        return;
     }
+    x = b;
+    householder_qmult(r, tau, x);
 }
 
+// Back substitution with the leading n x n triangle of r
 void scilib::QRdcmp::rsolve(VecDoub_I &b, VecDoub_O &x) {
     Int i, j;
     Doub sum;
     if (sing) {
         throw ("Attempting solve in a singular QR");
     }
+    VecDoub y(n);
     for (i = n - 1; i >= 0; i--) {
         sum = b[i];
         for (j = i + 1; j < n; j++) {
-            sum -= r[i][j] * x[j];
-            x[i] = sum / r[i][i];   
+            sum -= r[i][j] * y[j];
+        }
+        y[i] = sum / r[i][i];
+    }
+    x = y;
+}
+
+// ############ Updates ############
+
+// Givens rotation with c a - s b = sqrt(a^2 + b^2) and s a + c b = 0 when
+// called with (a, -b), as in rotate.
+static void qr_givens(const Doub a, const Doub b, Doub &c, Doub &s) {
+    Doub fact;
+    if (a == 0.0) {
+        c = 0.0;
+        s = (b >= 0.0 ? 1.0 : -1.0);
+    } else if (abs(a) > abs(b)) {
+        fact = b / a;
+        c = SIGN(1.0 / sqrt(1.0 + (fact * fact)), a);
+        s = fact * c;
+    } else {
+        fact = a / b;
+        s = SIGN(1.0 / sqrt(1.0 + (fact * fact)), b);
+        c = fact * s;
+    }
+}
+
+// Rotate rows i and i + 1 of x over columns [j0, j1)
+static void qr_rotrows(MatDoub &x, const Int i, const Doub c, const Doub s, const Int j0, const Int j1) {
+    Int j;
+    Doub y, w;
+    Doub *xi = x[i], *xi1 = x[i + 1];
+    for (j = j0; j < j1; j++) {
+        y = xi[j];
+        w = xi1[j];
+        xi[j] = c * y - s * w;
+        xi1[j] = s * y + c * w;
+    }
+}
+
+static Bool qr_singular(MatDoub_I &r) {
+    Int i, m = r.nrows(), n = r.ncols();
+    if (m < n) {
+        return true;
+    }
+    for (i = 0; i < n; i++) {
+        if (r[i][i] == 0.0) {
+            return true;
         }
     }
+    return false;
 }
 
 void scilib::QRdcmp::update(VecDoub_I &u, VecDoub_I &v) {
     Int i, k;
     VecDoub w(u);
-    for (k = n - 1; k >= 0; k--) {
+    formqt(); // the rotations act on qt
+    for (k = m - 1; k >= 0; k--) {
         if (w[k] != 0.0) {
             break;
         }
@@ -123,41 +470,197 @@ void scilib::QRdcmp::update(VecDoub_I &u, VecDoub_I &v) {
     for (i = 0; i < n; i++) {
         r[0][i] += w[0] * v[i];
     }
-    for (i = 0; i < k; i++) {
+    for (i = 0; i < MIN(k, n); i++) {
         rotate(i, r[i][i], -r[i + 1][i]);
     }
-    for (i = 0; i < n; i++) {
-        if (r[i][i] == 0.0) {
-            sing = true;
+    sing = qr_singular(r);
+}
+
+// R + U V^T: the columns of U are reduced to an upper-triangular k-row block
+// from the bottom up, which leaves R with k subdiagonals; the k rank-1 terms
+// then land in the top rows and a bulge-free sweep of adjacent rotations
+// restores the triangle column by column.
+void scilib::QRdcmp::update(MatDoub_I &u, MatDoub_I &v) {
+    Int i, j, c, k = u.ncols();
+    Doub cs, sn;
+    if (u.nrows() != m || v.nrows() != n || v.ncols() != k) {
+        throw("QRdcmp: bad sizes in update");
+    }
+    formqt();
+    MatDoub w(u);
+    for (c = 0; c < k; c++) {
+        for (i = m - 1; i > c; i--) {
+            if (w[i][c] != 0.0) {
+                qr_givens(w[i - 1][c], -w[i][c], cs, sn);
+                qr_rotrows(w, i - 1, cs, sn, c, k);
+                qr_rotrows(r, i - 1, cs, sn, MAX(0, i - 1 - c), n);
+                qr_rotrows(qt, i - 1, cs, sn, 0, m);
+            }
+        }
+    }
+    for (i = 0; i < MIN(k, m); i++) {
+        Doub *ri = r[i];
+        for (c = i; c < k; c++) {
+            for (j = 0; j < n; j++) {
+                ri[j] += w[i][c] * v[j][c];
+            }
+        }
+    }
+    for (j = 0; j < MIN(n, m - 1); j++) {
+        for (i = MIN(j + k, m - 1); i > j; i--) {
+            if (r[i][j] != 0.0) {
+                qr_givens(r[i - 1][j], -r[i][j], cs, sn);
+                qr_rotrows(r, i - 1, cs, sn, j, n);
+                qr_rotrows(qt, i - 1, cs, sn, 0, m);
+            }
         }
     }
+    sing = qr_singular(r);
 }
 
-void scilib::QRdcmp::rotate(const Int i, const Doub a, const Doub b) {
-    Int j;
-    Doub c, fact, s, w, y;
-    if (a == 0.0) {
-        c = 0.0;
-        s = (b >= 0.0 ? 1.0 : -1.0);
-    } else if (abs(a) > abs(b)) {
-        fact = b/a;
-        c = SIGN(1.0/sqrt(1.0 + (fact * fact)), a);
-        s = fact * c;
-    } else {
-        fact = a / b;
-        s = SIGN(1.0/sqrt(1.0+(fact * fact)), b);
-        c = fact * s;
+// The new column w = Q^T a is reduced to its first k + 1 entries from the
+// bottom up. The same rotations make R upper Hessenberg from column k on, and
+// shifting those columns right by one turns the subdiagonal into the diagonal.
+void scilib::QRdcmp::insertcol(const Int k, VecDoub_I &a) {
+    Int i, j;
+    Doub c, s, y;
+    if (k < 0 || k > n || a.size() != m) {
+        throw("QRdcmp: bad arguments to insertcol");
+    }
+    formqt();
+    VecDoub w(m);
+    qtmult(a, w);
+    for (i = m - 2; i >= k; i--) {
+        if (w[i + 1] != 0.0) {
+            qr_givens(w[i], -w[i + 1], c, s);
+            y = w[i];
+            w[i] = c * y - s * w[i + 1];
+            w[i + 1] = 0.0;
+            qr_rotrows(r, i, c, s, MIN(i, n), n);
+            qr_rotrows(qt, i, c, s, 0, m);
+        }
+    }
+    MatDoub rr(m, n + 1);
+    for (i = 0; i < m; i++) {
+        for (j = 0; j < k; j++) {
+            rr[i][j] = r[i][j];
+        }
+        rr[i][k] = w[i];
+        for (j = k; j < n; j++) {
+            rr[i][j + 1] = r[i][j];
+        }
+    }
+    r = rr;
+    n++;
+    sing = qr_singular(r);
+}
+
+// Dropping column k leaves R upper Hessenberg from column k on; one rotation
+// per column restores it.
+void scilib::QRdcmp::deletecol(const Int k) {
+    Int i, j;
+    Doub c, s;
+    if (k < 0 || k >= n) {
+        throw("QRdcmp: bad arguments to deletecol");
+    }
+    formqt();
+    MatDoub rr(m, n - 1);
+    for (i = 0; i < m; i++) {
+        for (j = 0; j < k; j++) {
+            rr[i][j] = r[i][j];
+        }
+        for (j = k + 1; j < n; j++) {
+            rr[i][j - 1] = r[i][j];
+        }
     }
-    for (j = i; j < n; j++) {
-        y = r[i][j];
-        w = r[i + 1][j];
-        r[i][j] = c * y - s * w;
-        r[i + 1][j] = s * y + c * w;
+    r = rr;
+    n--;
+    for (j = k; j < MIN(n, m - 1); j++) {
+        if (r[j + 1][j] != 0.0) {
+            qr_givens(r[j][j], -r[j + 1][j], c, s);
+            qr_rotrows(r, j, c, s, j, n);
+            qr_rotrows(qt, j, c, s, 0, m);
+            r[j + 1][j] = 0.0;
+        }
+    }
+    sing = qr_singular(r);
+}
+
+// The new row goes on top of R, making it upper Hessenberg, and Q gains a
+// unit row and column for it; the subdiagonal is then rotated away.
+void scilib::QRdcmp::insertrow(const Int k, VecDoub_I &a) {
+    Int i, j, jj;
+    Doub c, s;
+    if (k < 0 || k > m || a.size() != n) {
+        throw("QRdcmp: bad arguments to insertrow");
     }
+    formqt();
+    MatDoub rr(m + 1, n), qq(m + 1, m + 1, 0.0);
     for (j = 0; j < n; j++) {
-        y = qt[i][j];
-        w = qt[i + 1][j];
-        qt[i][j] = c * y - s * w;
-        qt[i + 1][j] = s * y + c * w;
+        rr[0][j] = a[j];
+    }
+    for (i = 0; i < m; i++) {
+        for (j = 0; j < n; j++) {
+            rr[i + 1][j] = r[i][j];
+        }
+        for (j = 0; j < m; j++) {
+            jj = (j < k ? j : j + 1);
+            qq[i + 1][jj] = qt[i][j];
+        }
+    }
+    qq[0][k] = 1.0;
+    r = rr;
+    qt = qq;
+    m++;
+    for (i = 0; i < MIN(n, m - 1); i++) {
+        if (r[i + 1][i] != 0.0) {
+            qr_givens(r[i][i], -r[i + 1][i], c, s);
+            qr_rotrows(r, i, c, s, i, n);
+            qr_rotrows(qt, i, c, s, 0, m);
+            r[i + 1][i] = 0.0;
+        }
+    }
+    sing = qr_singular(r);
+}
+
+// Rotations from the bottom up reduce column k of Q^T to a multiple of e_0,
+// turning R upper Hessenberg. The first row of Q^T is then e_k, so dropping
+// it and column k of Q^T, and the first row of R, leaves a QR of the rest.
+void scilib::QRdcmp::deleterow(const Int k) {
+    Int i, j, jj;
+    Doub c, s;
+    if (k < 0 || k >= m) {
+        throw("QRdcmp: bad arguments to deleterow");
+    }
+    formqt();
+    for (i = m - 2; i >= 0; i--) {
+        if (qt[i + 1][k] != 0.0) {
+            qr_givens(qt[i][k], -qt[i + 1][k], c, s);
+            qr_rotrows(r, i, c, s, MIN(i, n), n);
+            qr_rotrows(qt, i, c, s, 0, m);
+        }
+    }
+    MatDoub rr(m - 1, n), qq(m - 1, m - 1);
+    for (i = 1; i < m; i++) {
+        for (j = 0; j < n; j++) {
+            rr[i - 1][j] = r[i][j];
+        }
+        for (j = 0; j < m; j++) {
+            if (j != k) {
+                jj = (j < k ? j : j - 1);
+                qq[i - 1][jj] = qt[i][j];
+            }
+        }
     }
-}
\ No newline at end of file
+    r = rr;
+    qt = qq;
+    m--;
+    sing = qr_singular(r);
+}
+
+void scilib::QRdcmp::rotate(const Int i, const Doub a, const Doub b) {
+    Doub c, s;
+    qr_givens(a, b, c, s);
+    qr_rotrows(r, i, c, s, MIN(i, n), n);
+    qr_rotrows(qt, i, c, s, 0, m);
+}
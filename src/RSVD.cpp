@@ -0,0 +1,81 @@
+#include "../include/linalg.h"
+
+// ############ Randomized SVD ############
+
+// Standard normal deviates by Box-Muller on a 64-bit xorshift generator, so
+// the test matrix is reproducible from the seed alone.
+static void rsvd_gaussian(MatDoub &g, Ullong seed) {
+    Int i, j, k, n = g.nrows() * g.ncols();
+    Ullong v = 4101842887655102017LL ^ seed;
+    Doub u1, u2, r;
+    for (k = 0; k < n; k += 2) {
+        v ^= v >> 21; v ^= v << 35; v ^= v >> 4;
+        u1 = 5.42101086242752217E-20 * (v * 2685821657736338717LL) + 1.0e-300;
+        v ^= v >> 21; v ^= v << 35; v ^= v >> 4;
+        u2 = 5.42101086242752217E-20 * (v * 2685821657736338717LL);
+        r = sqrt(-2.0 * log(u1));
+        i = k / g.ncols();
+        j = k % g.ncols();
+        g[i][j] = r * cos(2.0 * M_PI * u2);
+        if (k + 1 < n) {
+            g[(k + 1) / g.ncols()][(k + 1) % g.ncols()] = r * sin(2.0 * M_PI * u2);
+        }
+    }
+}
+
+// Replace the columns of y by an orthonormal basis for their span: the first
+// l columns of Q from a Householder QR, built with blocked reflector updates.
+static void rsvd_orth(MatDoub &y, const Int nthreads) {
+    Int i, m = y.nrows(), l = y.ncols();
+    VecDoub tau;
+    scilib::householder_qr(y, tau, 32, nthreads);
+    MatDoub q(m, l, 0.0);
+    for (i = 0; i < l; i++) {
+        q[i][i] = 1.0;
+    }
+    scilib::householder_qmult(y, tau, q, 32, nthreads);
+    y = q;
+}
+
+// Range finder of Halko, Martinsson and Tropp: Q spans A G for a Gaussian
+// n x l test matrix G, l = k + oversample, sharpened by power iterations
+// (A A^T)^q A G that are re-orthonormalized at every step to keep the small
+// directions from being lost to rounding. B^T = A^T Q is n x l and its thin
+// SVD B^T = U_B W V_B^T gives A ~ (Q V_B) W U_B^T. Every pass over A is a
+// blocked product, so the cost is O(mnl) per pass.
+scilib::RSVD::RSVD(MatDoub_I &a, const Int kk, const Int oversample, const Int power, const Int nthreads, const Ullong seed) : m(a.nrows()), n(a.ncols()), k(kk) {
+    Int i, j, it, l = MIN(kk + MAX(oversample, 0), MIN(m, n));
+    if (kk < 1 || kk > MIN(m, n)) {
+        throw("RSVD: need 1 <= k <= min(m, n)");
+    }
+    MatDoub g(n, l), q, z;
+    rsvd_gaussian(g, seed);
+    matmul(a, g, q, nthreads);
+    rsvd_orth(q, nthreads);
+    for (it = 0; it < power; it++) {
+        matmul_tn(a, q, z, nthreads);
+        rsvd_orth(z, nthreads);
+        matmul(a, z, q, nthreads);
+        rsvd_orth(q, nthreads);
+    }
+    matmul_tn(a, q, z, nthreads);
+
+    SVD bt(z, SVD::THIN, nthreads);
+    MatDoub vb(l, k);
+    for (i = 0; i < l; i++) {
+        for (j = 0; j < k; j++) {
+            vb[i][j] = bt.v[i][j];
+        }
+    }
+    matmul(q, vb, u, nthreads);
+    w.resize(k);
+    v.resize(n, k);
+    for (j = 0; j < k; j++) {
+        w[j] = bt.w[j];
+    }
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < k; j++) {
+            v[i][j] = bt.u[i][j];
+        }
+    }
+}
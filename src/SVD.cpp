@@ -1,7 +1,72 @@
+#include <algorithm>
+#include <functional>
 #include "../include/nr3.h"
 #include "../include/linalg.h"
 
-Int scilib::SVD::rank(Doub thresh = -1.) {
+scilib::SVD::SVD(MatDoub_I &a, const Int opts, const Int nthreads) : m(a.nrows()), n(a.ncols()), w(n), vectors(!(opts & (VALUES | LAZY))), prepared(false), lazy(false), opts(opts), nthreads(nthreads) {
+    eps = numeric_limits<Doub>::epsilon();
+    if ((opts & LAZY) && !(opts & VALUES)) {
+        lazy = true;
+        ain = a;
+    }
+    if ((opts & THIN) && m > n) {
+        thin(a, opts, nthreads);
+    } else {
+        u = a;
+        if (vectors) {
+            v.resize(n, n);
+        }
+        if (opts & JACOBI) {
+            jacobi(nthreads);
+        } else {
+            decompose();
+        }
+        if (!vectors) {
+            u.resize(0, 0);
+        }
+    }
+    reorder();
+    tsh = 0.5 * sqrt(m + n + 1.) * w[0] * eps;
+}
+
+// a = Q R, R = u_R w v^T, so u = Q [u_R; 0]. The bidiagonalization then runs
+// on n x n instead of m x n, and u is formed with blocked reflector updates.
+void scilib::SVD::thin(MatDoub_I &a, const Int opts, const Int nthreads) {
+    Int i, j, mm = m;
+    MatDoub qr(a);
+    VecDoub tau;
+    householder_qr(qr, tau, 32, nthreads);
+    u.resize(n, n);
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            u[i][j] = (j >= i ? qr[i][j] : 0.0);
+        }
+    }
+    if (vectors) {
+        v.resize(n, n);
+    }
+    m = n;
+    if (opts & JACOBI) {
+        jacobi(nthreads);
+    } else {
+        decompose();
+    }
+    m = mm;
+    if (!vectors) {
+        u.resize(0, 0);
+        return;
+    }
+    MatDoub ur(u);
+    u.assign(m, n, 0.0);
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            u[i][j] = ur[i][j];
+        }
+    }
+    householder_qmult(qr, tau, u, 32, nthreads);
+}
+
+Int scilib::SVD::rank(Doub thresh) {
     Int j, nr=0;
     tsh = (thresh >= 0. ? thresh : 0.5*sqrt(m + n + 1)*w[0]*eps);
     for (j = 0; j < n; j++) {
@@ -12,7 +77,7 @@ Int scilib::SVD::rank(Doub thresh = -1.) {
     return nr;
 }
 
-Int scilib::SVD::nullity(Doub thresh = -1.) {
+Int scilib::SVD::nullity(Doub thresh) {
     Int j, nn = 0;
     tsh = (thresh >= 0. ? thresh : 0.5*sqrt(m + n + 1.)*w[0] *eps);
     for (j = 0; j < n; j++) {
@@ -23,8 +88,11 @@ Int scilib::SVD::nullity(Doub thresh = -1.) {
     return nn;
 }
 
-MatDoub scilib::SVD::range(Doub thresh = -1.) {
+MatDoub scilib::SVD::range(Doub thresh) {
     Int i, j, nr=0;
+    if (!vectors) {
+        formvectors();
+    }
     MatDoub range(m, rank(thresh));
     for (j = 0; j < n; j++) {
         if (w[j] > tsh) {
@@ -37,13 +105,16 @@ MatDoub scilib::SVD::range(Doub thresh = -1.) {
     return range;
 }
 
-MatDoub scilib::SVD::nullspace(Doub thresh = -1.) {
+MatDoub scilib::SVD::nullspace(Doub thresh) {
     Int j, jj, nn = 0;
+    if (!vectors) {
+        formvectors();
+    }
     MatDoub nullsp(n, nullity(thresh));
     for (j = 0; j < n; j++) {
         if (w[j] <= tsh) {
             for (jj = 0; jj < n; jj++) {
-                nullsp[jj][m] = v[jj][j];
+                nullsp[jj][nn] = v[jj][j];
             }
             nn++;
         }
@@ -51,47 +122,140 @@ MatDoub scilib::SVD::nullspace(Doub thresh = -1.) {
     return nullsp;
 }
 
-void scilib::SVD::solve(VecDoub_I &b, VecDoub_O &x, Doub thresh = -1.) {
+void scilib::SVD::solve(VecDoub_I &b, VecDoub_O &x, Doub thresh) {
     Int i, j, jj;
     Doub s;
-    if (b.size() != m || x.size()  != n) {
+    if (b.size() != m || x.size() != n) {
         throw ("SVD: Solve bad sizes");
     }
+    if (!vectors) {
+        formvectors();
+    }
     VecDoub tmp(n);
-    tsh =  (thresh >= 0. ? thresh : 0.5*sqrt(m+n+1.)*w[0]*eps);
+    tsh = (thresh >= 0. ? thresh : 0.5*sqrt(m+n+1.)*w[0]*eps);
     for (j = 0; j < n; j++) {
-        s=0.0;
+        s = 0.0;
         if (w[j] > tsh) {
             for (i = 0; i < m; i++) {
                 s += u[i][j] * b[i];
-                s /= w[j];
             }
+            s /= w[j];
         }
         tmp[j] = s;
     }
     for (j = 0; j < n; j++) {
-        s=0.0;
+        s = 0.0;
         for (jj = 0; jj < n; jj++) {
             s += v[j][jj] * tmp[jj];
-            x[j] = s;
         }
+        x[j] = s;
     }
 }
 
-void scilib::SVD::solve(MatDoub_I& b, MatDoub_O& x, Doub thresh = -1.) {
-    Int i, j, m = b.ncols();
-    if (b.nrows() != n || b.ncols() != m || b.ncols() != x.ncols()) {
+void scilib::SVD::solve(MatDoub_I& b, MatDoub_O& x, Doub thresh) {
+    Int i, j, p = b.ncols();
+    if (b.nrows() != m || x.nrows() != n || x.ncols() != p) {
         throw ("SVD: Solve bad shapes");
     }
-    VecDoub xx(n);
-    for (j = 0; j < m; j++) {
-        for (i = 0; i < n; i++) {
-            xx[i] = b[i][j];
+    VecDoub xb(m), xx(n);
+    for (j = 0; j < p; j++) {
+        for (i = 0; i < m; i++) {
+            xb[i] = b[i][j];
         }
-        solve(xx, xx, thresh);
+        solve(xb, xx, thresh);
         for (i = 0; i < n; i++) {
-            x[i][j] = xx[j];
+            x[i][j] = xx[i];
+        }
+    }
+}
+
+// A^+ = V_r diag(1/w_r) U_r^T over the r values above the threshold, kept as
+// the factors pv (n x r) and put (r x m), or multiplied out into pinv (n x m)
+// when r (m + n) >= m n and a single product is cheaper.
+void scilib::SVD::prepare(Doub thresh, const Int nthreads) {
+    Int i, j, r = rank(thresh);
+    if (!vectors) {
+        formvectors();
+    }
+    pthreads = nthreads;
+    pv.resize(n, r);
+    put.resize(r, m);
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < r; j++) {
+            pv[i][j] = v[i][j] / w[j];
+        }
+    }
+    for (j = 0; j < r; j++) {
+        for (i = 0; i < m; i++) {
+            put[j][i] = u[i][j];
+        }
+    }
+    if (Doub(r) * (m + n) >= Doub(m) * n) {
+        matmul(pv, put, pinv, nthreads);
+        pv.resize(0, 0);
+        put.resize(0, 0);
+    } else {
+        pinv.resize(0, 0);
+    }
+    prepared = true;
+}
+
+// y = a x, a row at a time
+static void svd_gemv(MatDoub_I &a, const Doub *x, Doub *y, const Int nthreads) {
+    Int i, j, m = a.nrows(), n = a.ncols();
+    Doub s0, s1, s2, s3;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1 && m * n > 100000) private(j, s0, s1, s2, s3) schedule(static)
+    for (i = 0; i < m; i++) {
+        const Doub *ai = a[i];
+        s0 = s1 = s2 = s3 = 0.0;
+        for (j = 0; j + 3 < n; j += 4) {
+            s0 += ai[j] * x[j];
+            s1 += ai[j + 1] * x[j + 1];
+            s2 += ai[j + 2] * x[j + 2];
+            s3 += ai[j + 3] * x[j + 3];
+        }
+        for (; j < n; j++) {
+            s0 += ai[j] * x[j];
         }
+        y[i] = (s0 + s1) + (s2 + s3);
+    }
+}
+
+void scilib::SVD::apply(VecDoub_I &b, VecDoub_O &x) {
+    if (!prepared) {
+        throw("SVD: apply before prepare");
+    }
+    if (b.size() != m) {
+        throw("SVD: apply bad sizes");
+    }
+    x.resize(n);
+    if (pinv.nrows() > 0) {
+        svd_gemv(pinv, &b[0], &x[0], pthreads);
+    } else if (put.nrows() > 0) {
+        VecDoub t(put.nrows());
+        svd_gemv(put, &b[0], &t[0], pthreads);
+        svd_gemv(pv, &t[0], &x[0], pthreads);
+    } else {
+        for (Int j = 0; j < n; j++) {
+            x[j] = 0.0;
+        }
+    }
+}
+
+// x = A^+ b for every column of b (m x p) at once
+void scilib::SVD::apply(MatDoub_I &b, MatDoub_O &x) {
+    if (!prepared) {
+        throw("SVD: apply before prepare");
+    }
+    if (b.nrows() != m) {
+        throw("SVD: apply bad shapes");
+    }
+    if (pinv.nrows() > 0) {
+        matmul(pinv, b, x, pthreads);
+    } else {
+        MatDoub t;
+        matmul(put, b, t, pthreads);
+        matmul(pv, t, x, pthreads);
     }
 }
 
@@ -147,7 +311,7 @@ void scilib::SVD::decompose() {
 		}
 		anorm=MAX(anorm,(abs(w[i])+abs(rv1[i])));
 	}
-	for (i=n-1;i>=0;i--) {
+	for (i=n-1;i>=0 && vectors;i--) {
 		if (i < n-1) {
 			if (g != 0.0) {
 				for (j=l;j<n;j++)
@@ -163,7 +327,7 @@ void scilib::SVD::decompose() {
 		g=rv1[i];
 		l=i;
 	}
-	for (i=MIN(m,n)-1;i>=0;i--) {
+	for (i=MIN(m,n)-1;i>=0 && vectors;i--) {
 		l=i+1;
 		g=w[i];
 		for (j=l;j<n;j++) u[i][j]=0.0;
@@ -202,7 +366,7 @@ void scilib::SVD::decompose() {
 					h=1.0/h;
 					c=g*h;
 					s = -f*h;
-					for (j=0;j<m;j++) {
+					if (vectors) for (j=0;j<m;j++) {
 						y=u[j][nm];
 						z=u[j][i];
 						u[j][nm]=y*c+z*s;
@@ -214,7 +378,7 @@ void scilib::SVD::decompose() {
 			if (l == k) {
 				if (z < 0.0) {
 					w[k] = -z;
-					for (j=0;j<n;j++) v[j][k] = -v[j][k];
+					if (vectors) for (j=0;j<n;j++) v[j][k] = -v[j][k];
 				}
 				break;
 			}
@@ -242,7 +406,7 @@ void scilib::SVD::decompose() {
 				g=g*c-x*s;
 				h=y*s;
 				y *= c;
-				for (jj=0;jj<n;jj++) {
+				if (vectors) for (jj=0;jj<n;jj++) {
 					x=v[jj][j];
 					z=v[jj][i];
 					v[jj][j]=x*c+z*s;
@@ -257,7 +421,7 @@ void scilib::SVD::decompose() {
 				}
 				f=c*g+s*y;
 				x=c*y-s*g;
-				for (jj=0;jj<m;jj++) {
+				if (vectors) for (jj=0;jj<m;jj++) {
 					y=u[jj][j];
 					z=u[jj][i];
 					u[jj][j]=y*c+z*s;
@@ -271,10 +435,165 @@ void scilib::SVD::decompose() {
 	}
 }
 
+// The LAZY constructor only found w; decompose the kept copy of a again with
+// vectors. The rebuilt w is identical, so w and the threshold the caller may
+// already have set are kept. Throws if the vectors were declined with VALUES.
+void scilib::SVD::formvectors() {
+    if (vectors) {
+        return;
+    }
+    if (!lazy) {
+        throw("SVD: vectors not computed");
+    }
+    SVD full(ain, opts & ~(VALUES | LAZY), nthreads);
+    u = full.u;
+    v = full.v;
+    vectors = true;
+    lazy = false;
+    ain.resize(0, 0);
+}
+
+// ############ One-Sided Jacobi ############
+
+// Rotate columns p and q of A (rows p and q of g = A^T) so they become
+// orthogonal, if they are not already to within tol. d holds the squared
+// column norms.
+static Int svd_jrot(MatDoub &g, MatDoub &vt, const Bool vectors, VecDoub &d, const Int p, const Int q, const Doub tol) {
+    Int i, m = g.ncols(), n = vt.ncols();
+    Doub gamma = 0.0, zeta, t, c, s, x, y;
+    Doub *gp = g[p], *gq = g[q];
+    for (i = 0; i < m; i++) {
+        gamma += gp[i] * gq[i];
+    }
+    if (abs(gamma) <= tol * sqrt(d[p] * d[q])) {
+        return 0;
+    }
+    zeta = (d[q] - d[p]) / (2.0 * gamma);
+    t = (zeta >= 0.0 ? 1.0 : -1.0) / (abs(zeta) + sqrt(1.0 + zeta * zeta));
+    c = 1.0 / sqrt(1.0 + t * t);
+    s = c * t;
+    for (i = 0; i < m; i++) {
+        x = gp[i];
+        y = gq[i];
+        gp[i] = c * x - s * y;
+        gq[i] = s * x + c * y;
+    }
+    if (vectors) {
+        Doub *vp = vt[p], *vq = vt[q];
+        for (i = 0; i < n; i++) {
+            x = vp[i];
+            y = vq[i];
+            vp[i] = c * x - s * y;
+            vq[i] = s * x + c * y;
+        }
+    }
+    d[p] -= t * gamma;
+    d[q] += t * gamma;
+    return 1;
+}
+
+// Hestenes one-sided Jacobi on the rows of g = A^T, so every rotation works on
+// contiguous memory. The columns are split into blocks of SVD_JBS; a sweep
+// first treats the pairs inside each block, then runs a round-robin tournament
+// over the blocks, where every round is a set of disjoint block pairs that
+// threads can rotate independently. Converges to high relative accuracy in
+// the small singular values, unlike bidiagonalization.
+static const Int SVD_JBS = 16;
+static const Int SVD_JSWEEPS = 60;
+
+void scilib::SVD::jacobi(const Int nthreads) {
+    Int i, j, b, p, q, r, sweep, nrot, nb = (n + SVD_JBS - 1) / SVD_JBS, nt = nb + (nb % 2);
+    const Doub tol = sqrt(Doub(MAX(m, 1))) * eps;
+    MatDoub g(n, m), vt(vectors ? n : 0, vectors ? n : 0);
+    VecDoub d(n);
+    VecInt order(nt);
+    for (i = 0; i < m; i++) {
+        for (j = 0; j < n; j++) {
+            g[j][i] = u[i][j];
+        }
+    }
+    for (i = 0; i < vt.nrows(); i++) {
+        for (j = 0; j < n; j++) {
+            vt[i][j] = (i == j ? 1.0 : 0.0);
+        }
+    }
+
+    for (sweep = 0; sweep < SVD_JSWEEPS; sweep++) {
+        for (j = 0; j < n; j++) {
+            for (d[j] = 0.0, i = 0; i < m; i++) {
+                d[j] += SQR(g[j][i]);
+            }
+        }
+        nrot = 0;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(p, q) reduction(+: nrot) schedule(dynamic)
+        for (b = 0; b < nb; b++) {
+            for (p = b * SVD_JBS; p < MIN((b + 1) * SVD_JBS, n); p++) {
+                for (q = p + 1; q < MIN((b + 1) * SVD_JBS, n); q++) {
+                    nrot += svd_jrot(g, vt, vectors, d, p, q, tol);
+                }
+            }
+        }
+        for (i = 0; i < nt; i++) {
+            order[i] = i;
+        }
+        for (r = 0; r < nt - 1; r++) {
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(p, q) reduction(+: nrot) schedule(dynamic)
+            for (b = 0; b < nt / 2; b++) {
+                Int bp = MIN(order[b], order[nt - 1 - b]), bq = MAX(order[b], order[nt - 1 - b]);
+                if (bq >= nb) {
+                    continue; // bye
+                }
+                for (p = bp * SVD_JBS; p < MIN((bp + 1) * SVD_JBS, n); p++) {
+                    for (q = bq * SVD_JBS; q < MIN((bq + 1) * SVD_JBS, n); q++) {
+                        nrot += svd_jrot(g, vt, vectors, d, p, q, tol);
+                    }
+                }
+            }
+            // circle method: keep order[0] fixed, rotate the rest by one
+            Int last = order[nt - 1];
+            for (i = nt - 1; i > 1; i--) {
+                order[i] = order[i - 1];
+            }
+            if (nt > 1) {
+                order[1] = last;
+            }
+        }
+        if (nrot == 0) {
+            break;
+        }
+    }
+    if (sweep == SVD_JSWEEPS) {
+        throw("no convergence in one-sided Jacobi SVD");
+    }
+
+    for (j = 0; j < n; j++) {
+        for (d[j] = 0.0, i = 0; i < m; i++) {
+            d[j] += SQR(g[j][i]);
+        }
+        w[j] = sqrt(d[j]);
+    }
+    if (vectors) {
+        for (i = 0; i < m; i++) {
+            for (j = 0; j < n; j++) {
+                u[i][j] = (w[j] > 0.0 ? g[j][i] / w[j] : 0.0);
+            }
+        }
+        for (i = 0; i < n; i++) {
+            for (j = 0; j < n; j++) {
+                v[i][j] = vt[j][i];
+            }
+        }
+    }
+}
+
 void scilib::SVD::reorder() {
 	Int i,j,k,s,inc=1;
 	Doub sw;
 	VecDoub su(m), sv(n);
+	if (!vectors) {
+		if (n > 0) sort(&w[0], &w[0] + n, greater<Doub>());
+		return;
+	}
 	do { inc *= 3; inc++; } while (inc <= n);
 	do {
 		inc /= 3;
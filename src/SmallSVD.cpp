@@ -0,0 +1,337 @@
+#include "../include/linalg.h"
+
+// ############ Batched 2x2 and 3x3 Kernels ############
+
+// Matrices are taken SK_LANES at a time and transposed into lane-interleaved
+// scratch, x[e][l] being entry e of matrix l, so that every scalar step of
+// the algorithm is one omp simd operation across the chunk (as BatchLU).
+// The kernels run a fixed number of Jacobi sweeps and replace each branch by
+// a select: four sweeps are ample for 3x3, where Jacobi converges
+// quadratically, and one rotation is exact for 2x2, with a second sweep
+// mopping up rounding. The sqrt in sk_tan vectorizes only when errno need
+// not be set: build this file with -fno-math-errno, not -ffast-math (which
+// would break the compensated sums elsewhere in the library, see eft.h).
+
+static const Int SK_LANES = 8;
+
+// tan of the Jacobi angle that zeroes the (p, q) entry, given the diagonal
+// entries app, aqq and the off-diagonal apq; 0 if apq is already 0.
+#pragma omp declare simd
+static inline Doub sk_tan(const Doub app, const Doub aqq, const Doub apq) {
+    Doub zeta = (aqq - app) / (2.0 * apq);
+    Doub t = (zeta >= 0.0 ? 1.0 : -1.0) / (abs(zeta) + sqrt(1.0 + zeta * zeta));
+    return (apq != 0.0 ? t : 0.0);
+}
+
+// Columns p and q of the N x N x: x_p = c x_p - s x_q, x_q = s x_p + c x_q
+template <Int N>
+static inline void sk_rotcols(Doub (*x)[SK_LANES], const Int p, const Int q, const Doub *c, const Doub *s) {
+    Int i, l;
+    for (i = 0; i < N; i++) {
+        Doub *xp = x[i * N + p], *xq = x[i * N + q];
+#pragma omp simd
+        for (l = 0; l < SK_LANES; l++) {
+            Doub g = xp[l], h = xq[l];
+            xp[l] = c[l] * g - s[l] * h;
+            xq[l] = s[l] * g + c[l] * h;
+        }
+    }
+}
+
+// Rows p and q likewise
+template <Int N>
+static inline void sk_rotrows(Doub (*x)[SK_LANES], const Int p, const Int q, const Doub *c, const Doub *s) {
+    Int i, l;
+    for (i = 0; i < N; i++) {
+        Doub *xp = x[p * N + i], *xq = x[q * N + i];
+#pragma omp simd
+        for (l = 0; l < SK_LANES; l++) {
+            Doub g = xp[l], h = xq[l];
+            xp[l] = c[l] * g - s[l] * h;
+            xq[l] = s[l] * g + c[l] * h;
+        }
+    }
+}
+
+// Compare-and-swap of entries q, q + 1 of d, carrying columns q, q + 1 of x
+// and y (y may be NULL), so that d ends up decreasing.
+template <Int N>
+static inline void sk_sortstep(Doub (*d)[SK_LANES], Doub (*x)[SK_LANES], Doub (*y)[SK_LANES], const Int q) {
+    Int i, l;
+    Bool sw[SK_LANES];
+#pragma omp simd
+    for (l = 0; l < SK_LANES; l++) {
+        Doub d0 = d[q][l], d1 = d[q + 1][l];
+        sw[l] = d0 < d1;
+        d[q][l] = sw[l] ? d1 : d0;
+        d[q + 1][l] = sw[l] ? d0 : d1;
+    }
+    for (i = 0; i < N; i++) {
+        Doub *x0 = x[i * N + q], *x1 = x[i * N + q + 1];
+#pragma omp simd
+        for (l = 0; l < SK_LANES; l++) {
+            Doub g = x0[l], h = x1[l];
+            x0[l] = sw[l] ? h : g;
+            x1[l] = sw[l] ? g : h;
+        }
+        if (y != NULL) {
+            Doub *y0 = y[i * N + q], *y1 = y[i * N + q + 1];
+#pragma omp simd
+            for (l = 0; l < SK_LANES; l++) {
+                Doub g = y0[l], h = y1[l];
+                y0[l] = sw[l] ? h : g;
+                y1[l] = sw[l] ? g : h;
+            }
+        }
+    }
+}
+
+// Load nl matrices of a (row-major, N N apart) into lanes; the rest are zero
+template <Int N>
+static inline void sk_load(const Doub *a, Doub (*x)[SK_LANES], const Int nl) {
+    Int e, l;
+    for (l = 0; l < SK_LANES; l++) {
+        for (e = 0; e < N * N; e++) {
+            x[e][l] = (l < nl ? a[l * N * N + e] : 0.0);
+        }
+    }
+}
+
+template <Int N>
+static inline void sk_store(Doub (*x)[SK_LANES], Doub *a, const Int stride, const Int nl) {
+    Int e, l;
+    for (l = 0; l < nl; l++) {
+        for (e = 0; e < stride; e++) {
+            a[l * stride + e] = x[e][l];
+        }
+    }
+}
+
+template <Int N>
+static inline void sk_identity(Doub (*x)[SK_LANES]) {
+    for (Int e = 0; e < N * N; e++) {
+        for (Int l = 0; l < SK_LANES; l++) {
+            x[e][l] = (e % (N + 1) == 0 ? 1.0 : 0.0);
+        }
+    }
+}
+
+// One-sided Jacobi: rotate the columns of a until they are orthogonal, with
+// the same rotations accumulated in v; then w holds the column norms and u
+// the normalized columns, sorted so that w decreases. Columns of u whose w
+// is 0 are completed to an orthonormal basis, so u is always orthogonal (as
+// polar decompositions and rotation fitting need).
+template <Int N, Int SWEEPS>
+static void sk_svd(const Doub *a, Doub *u, Doub *w, Doub *v, const Int nl) {
+    const Int L = SK_LANES;
+    const Doub EPS = numeric_limits<Doub>::epsilon();
+    Int i, j, p, q, l, sweep;
+    Doub g[N * N][SK_LANES], vv[N * N][SK_LANES], ww[N][SK_LANES], uu[N * N][SK_LANES];
+    Doub al[SK_LANES], be[SK_LANES], ga[SK_LANES], c[SK_LANES], s[SK_LANES], sc[SK_LANES];
+    sk_load<N>(a, g, nl);
+    sk_identity<N>(vv);
+
+    // scale each lane by max|a_ij| so the sums of squares below neither
+    // overflow nor underflow; w is scaled back at the end. Dividing rather
+    // than multiplying by the reciprocal keeps a denormal max finite.
+    for (l = 0; l < L; l++) {
+        sc[l] = 0.0;
+    }
+    for (i = 0; i < N * N; i++) {
+#pragma omp simd
+        for (l = 0; l < L; l++) {
+            sc[l] = MAX(sc[l], abs(g[i][l]));
+        }
+    }
+#pragma omp simd
+    for (l = 0; l < L; l++) {
+        sc[l] = (sc[l] > 0.0 ? sc[l] : 1.0);
+    }
+    for (i = 0; i < N * N; i++) {
+#pragma omp simd
+        for (l = 0; l < L; l++) {
+            g[i][l] /= sc[l];
+        }
+    }
+
+    for (sweep = 0; sweep < SWEEPS; sweep++) {
+        for (p = 0; p < N - 1; p++) {
+            for (q = p + 1; q < N; q++) {
+                for (l = 0; l < L; l++) {
+                    al[l] = be[l] = ga[l] = 0.0;
+                }
+                for (i = 0; i < N; i++) {
+                    const Doub *gp = g[i * N + p], *gq = g[i * N + q];
+#pragma omp simd
+                    for (l = 0; l < L; l++) {
+                        al[l] += gp[l] * gp[l];
+                        be[l] += gq[l] * gq[l];
+                        ga[l] += gp[l] * gq[l];
+                    }
+                }
+#pragma omp simd
+                for (l = 0; l < L; l++) {
+                    Doub t = sk_tan(al[l], be[l], ga[l]);
+                    c[l] = 1.0 / sqrt(1.0 + t * t);
+                    s[l] = c[l] * t;
+                }
+                sk_rotcols<N>(g, p, q, c, s);
+                sk_rotcols<N>(vv, p, q, c, s);
+            }
+        }
+    }
+    for (j = 0; j < N; j++) {
+        for (l = 0; l < L; l++) {
+            ww[j][l] = 0.0;
+        }
+        for (i = 0; i < N; i++) {
+#pragma omp simd
+            for (l = 0; l < L; l++) {
+                ww[j][l] += g[i * N + j][l] * g[i * N + j][l];
+            }
+        }
+#pragma omp simd
+        for (l = 0; l < L; l++) {
+            ww[j][l] = sqrt(ww[j][l]);
+        }
+    }
+    for (p = 0; p < N - 1; p++) {
+        for (q = 0; q < N - 1 - p; q++) {
+            sk_sortstep<N>(ww, g, vv, q);
+        }
+    }
+
+    for (j = 0; j < N; j++) {
+        for (i = 0; i < N; i++) {
+#pragma omp simd
+            for (l = 0; l < L; l++) {
+                Doub tiny = N * EPS * ww[0][l];
+                uu[i * N + j][l] = (ww[j][l] > tiny ? g[i * N + j][l] / ww[j][l] : 0.0);
+            }
+        }
+    }
+#pragma omp simd
+    for (l = 0; l < L; l++) {
+        Doub tiny = N * EPS * ww[0][l];
+        Bool z0 = !(ww[0][l] > 0.0), z1 = !(ww[1][l] > tiny);
+        if (N == 2) {
+            uu[0][l] = z0 ? 1.0 : uu[0][l];
+            uu[2][l] = z0 ? 0.0 : uu[2][l];
+            uu[1][l] = z1 ? -uu[2][l] : uu[1][l];
+            uu[3][l] = z1 ? uu[0][l] : uu[3][l];
+        } else {
+            // u_0 = e_0 for a zero matrix; u_1 = u_0 x e_k with e_k the axis
+            // least aligned with u_0; u_2 = u_0 x u_1
+            Bool z2 = !(ww[N - 1][l] > tiny);
+            Doub u0 = z0 ? 1.0 : uu[0][l], u3 = z0 ? 0.0 : uu[N][l], u6 = z0 ? 0.0 : uu[2 * N][l];
+            Doub x0 = abs(u0), x1 = abs(u3), x2 = abs(u6);
+            Bool k0 = x0 <= x1 && x0 <= x2, k1 = !k0 && x1 <= x2;
+            Doub e0 = k0 ? 1.0 : 0.0, e1 = k1 ? 1.0 : 0.0, e2 = (!k0 && !k1) ? 1.0 : 0.0;
+            Doub c0 = u3 * e2 - u6 * e1, c1 = u6 * e0 - u0 * e2, c2 = u0 * e1 - u3 * e0;
+            Doub r = 1.0 / sqrt(c0 * c0 + c1 * c1 + c2 * c2);
+            Doub u1 = z1 ? c0 * r : uu[1][l], u4 = z1 ? c1 * r : uu[N + 1][l], u7 = z1 ? c2 * r : uu[2 * N + 1][l];
+            uu[0][l] = u0;
+            uu[N][l] = u3;
+            uu[2 * N][l] = u6;
+            uu[1][l] = u1;
+            uu[N + 1][l] = u4;
+            uu[2 * N + 1][l] = u7;
+            uu[2][l] = z2 ? u3 * u7 - u6 * u4 : uu[2][l];
+            uu[N + 2][l] = z2 ? u6 * u1 - u0 * u7 : uu[N + 2][l];
+            uu[2 * N + 2][l] = z2 ? u0 * u4 - u3 * u1 : uu[2 * N + 2][l];
+        }
+    }
+    for (j = 0; j < N; j++) {
+#pragma omp simd
+        for (l = 0; l < L; l++) {
+            ww[j][l] *= sc[l];
+        }
+    }
+    sk_store<N>(uu, u, N * N, nl);
+    sk_store<N>(ww, w, N, nl);
+    sk_store<N>(vv, v, N * N, nl);
+}
+
+// Cyclic two-sided Jacobi on the symmetric a: d the eigenvalues in
+// decreasing order and z the eigenvectors as columns, as Symmeig.
+template <Int N, Int SWEEPS>
+static void sk_symeig(const Doub *a, Doub *d, Doub *z, const Int nl) {
+    const Int L = SK_LANES;
+    Int i, p, q, l, sweep;
+    Doub b[N * N][SK_LANES], zz[N * N][SK_LANES], dd[N][SK_LANES], c[SK_LANES], s[SK_LANES];
+    sk_load<N>(a, b, nl);
+    sk_identity<N>(zz);
+    for (sweep = 0; sweep < SWEEPS; sweep++) {
+        for (p = 0; p < N - 1; p++) {
+            for (q = p + 1; q < N; q++) {
+                const Doub *bpp = b[p * N + p], *bqq = b[q * N + q], *bpq = b[p * N + q];
+#pragma omp simd
+                for (l = 0; l < L; l++) {
+                    Doub t = sk_tan(bpp[l], bqq[l], bpq[l]);
+                    c[l] = 1.0 / sqrt(1.0 + t * t);
+                    s[l] = c[l] * t;
+                }
+                sk_rotcols<N>(b, p, q, c, s);
+                sk_rotrows<N>(b, p, q, c, s);
+                sk_rotcols<N>(zz, p, q, c, s);
+            }
+        }
+    }
+    for (i = 0; i < N; i++) {
+        for (l = 0; l < L; l++) {
+            dd[i][l] = b[i * N + i][l];
+        }
+    }
+    for (p = 0; p < N - 1; p++) {
+        for (q = 0; q < N - 1 - p; q++) {
+            sk_sortstep<N>(dd, zz, NULL, q);
+        }
+    }
+    sk_store<N>(dd, d, N, nl);
+    sk_store<N>(zz, z, N * N, nl);
+}
+
+template <Int N, Int SWEEPS>
+static void sk_svd_batch(VecDoub_I &a, VecDoub_O &u, VecDoub_O &w, VecDoub_O &v, const Int nthreads) {
+    Int k, count = a.size() / (N * N);
+    if (a.size() != count * N * N) {
+        throw("batched svd: bad sizes");
+    }
+    u.resize(count * N * N);
+    w.resize(count * N);
+    v.resize(count * N * N);
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(static)
+    for (k = 0; k < count; k += SK_LANES) {
+        sk_svd<N, SWEEPS>(&a[k * N * N], &u[k * N * N], &w[k * N], &v[k * N * N], MIN(SK_LANES, count - k));
+    }
+}
+
+template <Int N, Int SWEEPS>
+static void sk_symeig_batch(VecDoub_I &a, VecDoub_O &d, VecDoub_O &z, const Int nthreads) {
+    Int k, count = a.size() / (N * N);
+    if (a.size() != count * N * N) {
+        throw("batched symeig: bad sizes");
+    }
+    d.resize(count * N);
+    z.resize(count * N * N);
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(static)
+    for (k = 0; k < count; k += SK_LANES) {
+        sk_symeig<N, SWEEPS>(&a[k * N * N], &d[k * N], &z[k * N * N], MIN(SK_LANES, count - k));
+    }
+}
+
+void scilib::svd2x2(VecDoub_I &a, VecDoub_O &u, VecDoub_O &w, VecDoub_O &v, const Int nthreads) {
+    sk_svd_batch<2, 2>(a, u, w, v, nthreads);
+}
+
+void scilib::svd3x3(VecDoub_I &a, VecDoub_O &u, VecDoub_O &w, VecDoub_O &v, const Int nthreads) {
+    sk_svd_batch<3, 4>(a, u, w, v, nthreads);
+}
+
+void scilib::symeig2x2(VecDoub_I &a, VecDoub_O &d, VecDoub_O &z, const Int nthreads) {
+    sk_symeig_batch<2, 2>(a, d, z, nthreads);
+}
+
+void scilib::symeig3x3(VecDoub_I &a, VecDoub_O &d, VecDoub_O &z, const Int nthreads) {
+    sk_symeig_batch<3, 4>(a, d, z, nthreads);
+}
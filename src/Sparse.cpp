@@ -0,0 +1,481 @@
+#include <algorithm>
+#include "../include/sparse.h"
+
+// ############ Compressed Sparse Row Matrix ############
+
+scilib::SparseMat::SparseMat() : nrows(0), ncols(0), nnz(0), row_ptr(1, 0) {}
+
+scilib::SparseMat::SparseMat(Int m, Int n, Int nnvals) : nrows(m), ncols(n), nnz(nnvals), row_ptr(m + 1, 0), col_ind(nnvals), val(nnvals) {}
+
+// Two counting sorts, first by column then by row, leave every row sorted by
+// column with duplicates adjacent; duplicates are then summed in place.
+scilib::SparseMat::SparseMat(Int m, Int n, VecInt_I &ti, VecInt_I &tj, VecDoub_I &tv) : nrows(m), ncols(n), nnz(0), row_ptr(m + 1, 0) {
+    Int i, j, k, p, q, nt = ti.size();
+    if (tj.size() != nt || tv.size() != nt) {
+        throw("SparseMat: bad triplet sizes");
+    }
+    VecInt cptr(n + 1, 0), crow(nt), next(MAX(m, n));
+    VecDoub cv(nt);
+    for (k = 0; k < nt; k++) {
+        if (ti[k] < 0 || ti[k] >= m || tj[k] < 0 || tj[k] >= n) {
+            throw("SparseMat: triplet index out of range");
+        }
+        cptr[tj[k] + 1]++;
+    }
+    for (j = 0; j < n; j++) {
+        cptr[j + 1] += cptr[j];
+        next[j] = cptr[j];
+    }
+    for (k = 0; k < nt; k++) {
+        p = next[tj[k]]++;
+        crow[p] = ti[k];
+        cv[p] = tv[k];
+    }
+
+    VecInt cols(nt);
+    VecDoub vals(nt);
+    for (k = 0; k < nt; k++) {
+        row_ptr[ti[k] + 1]++;
+    }
+    for (i = 0; i < m; i++) {
+        row_ptr[i + 1] += row_ptr[i];
+        next[i] = row_ptr[i];
+    }
+    for (j = 0; j < n; j++) {
+        for (p = cptr[j]; p < cptr[j + 1]; p++) {
+            q = next[crow[p]]++;
+            cols[q] = j;
+            vals[q] = cv[p];
+        }
+    }
+
+    col_ind.resize(nt);
+    val.resize(nt);
+    for (i = 0; i < m; i++) {
+        p = row_ptr[i];
+        row_ptr[i] = nnz;
+        for (q = p; q < next[i]; q++) {
+            if (nnz > row_ptr[i] && col_ind[nnz - 1] == cols[q]) {
+                val[nnz - 1] += vals[q];
+            } else {
+                col_ind[nnz] = cols[q];
+                val[nnz++] = vals[q];
+            }
+        }
+    }
+    row_ptr[m] = nnz;
+}
+
+void scilib::SparseMat::ax(VecDoub_I &x, VecDoub_O &y, const Int nthreads) const {
+    Int i, p;
+    Doub sum;
+    if (x.size() != ncols || y.size() != nrows) {
+        throw("SparseMat: bad sizes in ax");
+    }
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(p, sum) schedule(static)
+    for (i = 0; i < nrows; i++) {
+        sum = 0.0;
+        for (p = row_ptr[i]; p < row_ptr[i + 1]; p++) {
+            sum += val[p] * x[col_ind[p]];
+        }
+        y[i] = sum;
+    }
+}
+
+void scilib::SparseMat::atx(VecDoub_I &x, VecDoub_O &y) const {
+    Int i, p;
+    if (x.size() != nrows || y.size() != ncols) {
+        throw("SparseMat: bad sizes in atx");
+    }
+    for (i = 0; i < ncols; i++) {
+        y[i] = 0.0;
+    }
+    for (i = 0; i < nrows; i++) {
+        for (p = row_ptr[i]; p < row_ptr[i + 1]; p++) {
+            y[col_ind[p]] += val[p] * x[i];
+        }
+    }
+}
+
+scilib::SparseMat scilib::SparseMat::transpose() const {
+    Int i, j, p, q;
+    SparseMat at(ncols, nrows, nnz);
+    VecInt next(ncols);
+    for (p = 0; p < nnz; p++) {
+        at.row_ptr[col_ind[p] + 1]++;
+    }
+    for (j = 0; j < ncols; j++) {
+        at.row_ptr[j + 1] += at.row_ptr[j];
+        next[j] = at.row_ptr[j];
+    }
+    for (i = 0; i < nrows; i++) {
+        for (p = row_ptr[i]; p < row_ptr[i + 1]; p++) {
+            q = next[col_ind[p]]++;
+            at.col_ind[q] = i;
+            at.val[q] = val[p];
+        }
+    }
+    return at;
+}
+
+// ############ Minimum Degree Ordering ############
+
+// Approximate minimum degree (Amestoy, Davis and Duff 1996) on the quotient
+// graph. An eliminated node becomes an element standing for the clique of its
+// neighbours, so the fill is never stored: variable i keeps the elements it
+// belongs to (elts) and its remaining original neighbours (adj), element e the
+// variables of its clique. Elements covered by a newer one are absorbed,
+// variables with the same elements and neighbours are merged into
+// supervariables and ordered together, and the exact degree is replaced by the
+// AMD upper bound. A step then costs about the size of the lists it touches
+// rather than the fill it creates, and storage stays O(nnz(a)).
+
+static const Int MD_VAR = 0, MD_ELT = 1, MD_DEAD = 2;
+
+// Degree lists: head[d] starts a doubly linked list of the variables of
+// (approximate) degree d.
+static inline void md_insert(const Int i, const Int d, VecInt &head, VecInt &next, VecInt &last) {
+    next[i] = head[d];
+    last[i] = -1;
+    if (head[d] != -1) {
+        last[head[d]] = i;
+    }
+    head[d] = i;
+}
+
+static inline void md_remove(const Int i, const Int d, VecInt &head, VecInt &next, VecInt &last) {
+    if (next[i] != -1) {
+        last[next[i]] = last[i];
+    }
+    if (last[i] != -1) {
+        next[last[i]] = next[i];
+    } else {
+        head[d] = next[i];
+    }
+}
+
+void scilib::mindegree(const SparseMat &a, VecInt_O &perm) {
+    Int i, j, k, p, q, r, e, s, dext, wp, nleft, mindeg, stamp, tag = 0, n = a.nrows;
+    Uint h;
+    vector<vector<Int> > adj(n), elts(n), clique(n);
+    vector<Int> lp;
+    vector<pair<Uint, Int> > byhash;
+    VecInt nv(n, 1), deg(n), state(n, MD_VAR), ew(n, 0), wv(n, 0);
+    VecInt head(MAX(n, 1), -1), next(n), last(n), mem(n, -1), memlast(n);
+    VecInt inlp(n, -1), emark(n, -1), cmark(n, -1);
+
+    for (i = 0; i < n; i++) {
+        for (p = a.row_ptr[i]; p < a.row_ptr[i + 1]; p++) {
+            j = a.col_ind[p];
+            if (j != i) {
+                adj[i].push_back(j);
+                adj[j].push_back(i);
+            }
+        }
+    }
+    for (i = 0; i < n; i++) {
+        sort(adj[i].begin(), adj[i].end());
+        adj[i].erase(unique(adj[i].begin(), adj[i].end()), adj[i].end());
+        deg[i] = adj[i].size();
+        memlast[i] = i;
+        md_insert(i, deg[i], head, next, last);
+    }
+
+    perm.resize(n);
+    nleft = n;
+    mindeg = 0;
+    for (k = 0, stamp = 0; k < n; stamp++) {
+        // pivot: a supervariable of least degree, ordered as a block
+        while (head[mindeg] == -1) {
+            mindeg++;
+        }
+        p = head[mindeg];
+        md_remove(p, mindeg, head, next, last);
+        for (i = p; i != -1; i = mem[i]) {
+            perm[k++] = i;
+        }
+        nleft -= nv[p];
+
+        // the new element: neighbours of p and members of its elements, which
+        // it absorbs
+        lp.clear();
+        wp = 0;
+        inlp[p] = stamp;
+        for (q = 0; q < Int(adj[p].size()); q++) {
+            j = adj[p][q];
+            if (state[j] == MD_VAR && inlp[j] != stamp) {
+                inlp[j] = stamp;
+                lp.push_back(j);
+                wp += nv[j];
+            }
+        }
+        for (q = 0; q < Int(elts[p].size()); q++) {
+            e = elts[p][q];
+            if (state[e] != MD_ELT) {
+                continue;
+            }
+            for (r = 0; r < Int(clique[e].size()); r++) {
+                j = clique[e][r];
+                if (state[j] == MD_VAR && inlp[j] != stamp) {
+                    inlp[j] = stamp;
+                    lp.push_back(j);
+                    wp += nv[j];
+                }
+            }
+            state[e] = MD_DEAD;
+            vector<Int>().swap(clique[e]);
+        }
+        state[p] = MD_ELT;
+        vector<Int>().swap(adj[p]);
+        vector<Int>().swap(elts[p]);
+        for (q = 0; q < Int(lp.size()); q++) {
+            md_remove(lp[q], deg[lp[q]], head, next, last);
+        }
+
+        // wv[e] = |L_e \ L_p| (weighted) for the other elements next to L_p
+        for (q = 0; q < Int(lp.size()); q++) {
+            i = lp[q];
+            for (r = 0; r < Int(elts[i].size()); r++) {
+                e = elts[i][r];
+                if (state[e] != MD_ELT) {
+                    continue;
+                }
+                if (emark[e] != stamp) {
+                    emark[e] = stamp;
+                    wv[e] = ew[e];
+                }
+                wv[e] -= nv[i];
+            }
+        }
+
+        // prune the lists of L_p, absorb elements inside L_p and bound the
+        // degrees by min(old + |L_p \ i|, |L_p \ i| + sum |L_e \ L_p| + |A_i|)
+        byhash.clear();
+        for (q = 0; q < Int(lp.size()); q++) {
+            i = lp[q];
+            dext = 0;
+            h = p;
+            for (r = s = 0; r < Int(elts[i].size()); r++) {
+                e = elts[i][r];
+                if (state[e] != MD_ELT) {
+                    continue;
+                }
+                if (wv[e] == 0) {
+                    state[e] = MD_DEAD; // L_e is a subset of L_p
+                    vector<Int>().swap(clique[e]);
+                    continue;
+                }
+                dext += wv[e];
+                h += e;
+                elts[i][s++] = e;
+            }
+            elts[i].resize(s);
+            elts[i].push_back(p);
+            for (r = s = 0; r < Int(adj[i].size()); r++) {
+                j = adj[i][r];
+                if (state[j] != MD_VAR || inlp[j] == stamp) {
+                    continue; // eliminated, merged, or now reached through p
+                }
+                dext += nv[j];
+                h += j;
+                adj[i][s++] = j;
+            }
+            adj[i].resize(s);
+            deg[i] = MAX(0, MIN(nleft - nv[i], MIN(deg[i], dext) + wp - nv[i]));
+            byhash.push_back(make_pair(h, i));
+        }
+
+        // supervariables: equal hashes first, then compare the lists
+        sort(byhash.begin(), byhash.end());
+        for (q = 0; q < Int(byhash.size()); q++) {
+            i = byhash[q].second;
+            if (nv[i] == 0) {
+                continue;
+            }
+            Bool marked = false;
+            for (r = q + 1; r < Int(byhash.size()) && byhash[r].first == byhash[q].first; r++) {
+                j = byhash[r].second;
+                if (nv[j] == 0 || elts[j].size() != elts[i].size() || adj[j].size() != adj[i].size()) {
+                    continue;
+                }
+                if (!marked) { // tag the lists of i once
+                    tag++;
+                    for (s = 0; s < Int(elts[i].size()); s++) {
+                        cmark[elts[i][s]] = tag;
+                    }
+                    for (s = 0; s < Int(adj[i].size()); s++) {
+                        cmark[adj[i][s]] = tag;
+                    }
+                    marked = true;
+                }
+                for (s = 0; s < Int(elts[j].size()) && cmark[elts[j][s]] == tag; s++) {}
+                if (s < Int(elts[j].size())) {
+                    continue;
+                }
+                for (s = 0; s < Int(adj[j].size()) && cmark[adj[j][s]] == tag; s++) {}
+                if (s < Int(adj[j].size())) {
+                    continue;
+                }
+                nv[i] += nv[j];
+                deg[i] = MAX(0, deg[i] - nv[j]);
+                nv[j] = 0;
+                state[j] = MD_DEAD;
+                mem[memlast[i]] = j;
+                memlast[i] = memlast[j];
+                vector<Int>().swap(elts[j]);
+                vector<Int>().swap(adj[j]);
+            }
+        }
+
+        for (q = 0; q < Int(lp.size()); q++) {
+            i = lp[q];
+            if (nv[i] > 0) {
+                clique[p].push_back(i);
+                md_insert(i, deg[i], head, next, last);
+                mindeg = MIN(mindeg, deg[i]);
+            }
+        }
+        ew[p] = wp;
+    }
+}
+
+// ############ Sparse Cholesky Decomposition ############
+
+// Nonzero pattern of row k of L: the nodes reached from the entries of row k
+// of P A P^T by walking up the elimination tree, returned in
+// stack[top .. n-1] in topological order.
+static Int sp_ereach(const scilib::SparseMat &a, const Int k, VecInt_I &perm, VecInt_I &pinv, VecInt_I &parent, VecInt &stack, VecInt &flag) {
+    Int i, p, len, top = a.nrows, row = perm[k];
+    flag[k] = k;
+    for (p = a.row_ptr[row]; p < a.row_ptr[row + 1]; p++) {
+        i = pinv[a.col_ind[p]];
+        if (i > k) {
+            continue;
+        }
+        for (len = 0; flag[i] != k; i = parent[i]) {
+            stack[len++] = i;
+            flag[i] = k;
+        }
+        while (len > 0) {
+            stack[--top] = stack[--len];
+        }
+    }
+    return top;
+}
+
+scilib::SparseCholesky::SparseCholesky(const SparseMat &a, Bool order) : n(a.nrows), perm(n), pinv(n), parent(n), lp(n + 1) {
+    Int i, j, k, p, q, top, inext, row;
+    Doub d, lkj;
+    if (a.ncols != n) {
+        throw("SparseCholesky: need square matrix");
+    }
+    if (order) {
+        mindegree(a, perm);
+    } else {
+        for (k = 0; k < n; k++) {
+            perm[k] = k;
+        }
+    }
+    for (k = 0; k < n; k++) {
+        pinv[perm[k]] = k;
+    }
+
+    // elimination tree, with path compression through ancestor
+    VecInt ancestor(n);
+    for (k = 0; k < n; k++) {
+        parent[k] = ancestor[k] = -1;
+        row = perm[k];
+        for (p = a.row_ptr[row]; p < a.row_ptr[row + 1]; p++) {
+            for (i = pinv[a.col_ind[p]]; i != -1 && i < k; i = inext) {
+                inext = ancestor[i];
+                ancestor[i] = k;
+                if (inext == -1) {
+                    parent[i] = k;
+                }
+            }
+        }
+    }
+
+    // column counts from the row patterns
+    VecInt stack(n), flag(n, -1), cnt(n, 1), next(n);
+    for (k = 0; k < n; k++) {
+        top = sp_ereach(a, k, perm, pinv, parent, stack, flag);
+        for (p = top; p < n; p++) {
+            cnt[stack[p]]++;
+        }
+    }
+    lp[0] = 0;
+    for (j = 0; j < n; j++) {
+        lp[j + 1] = lp[j] + cnt[j];
+        next[j] = lp[j] + 1;
+        flag[j] = -1;
+    }
+    li.resize(lp[n]);
+    lx.resize(lp[n]);
+
+    // row k of L from a sparse triangular solve against the rows above it
+    VecDoub x(n, 0.0);
+    for (k = 0; k < n; k++) {
+        top = sp_ereach(a, k, perm, pinv, parent, stack, flag);
+        row = perm[k];
+        for (p = a.row_ptr[row]; p < a.row_ptr[row + 1]; p++) {
+            j = pinv[a.col_ind[p]];
+            if (j <= k) {
+                x[j] += a.val[p];
+            }
+        }
+        d = x[k];
+        x[k] = 0.0;
+        for (; top < n; top++) {
+            j = stack[top];
+            lkj = x[j] / lx[lp[j]];
+            x[j] = 0.0;
+            for (q = lp[j] + 1; q < next[j]; q++) {
+                x[li[q]] -= lx[q] * lkj;
+            }
+            d -= lkj * lkj;
+            q = next[j]++;
+            li[q] = k;
+            lx[q] = lkj;
+        }
+        if (d <= 0.0) {
+            throw("SparseCholesky failed");
+        }
+        li[lp[k]] = k;
+        lx[lp[k]] = sqrt(d);
+    }
+}
+
+void scilib::SparseCholesky::solve(VecDoub_I &b, VecDoub_O &x) {
+    Int j, p;
+    if (b.size() != n || x.size() != n) {
+        throw("SparseCholesky: bad sizes in solve");
+    }
+    VecDoub y(n);
+    for (j = 0; j < n; j++) {
+        y[j] = b[perm[j]];
+    }
+    for (j = 0; j < n; j++) {
+        y[j] /= lx[lp[j]];
+        for (p = lp[j] + 1; p < lp[j + 1]; p++) {
+            y[li[p]] -= lx[p] * y[j];
+        }
+    }
+    for (j = n - 1; j >= 0; j--) {
+        for (p = lp[j] + 1; p < lp[j + 1]; p++) {
+            y[j] -= lx[p] * y[li[p]];
+        }
+        y[j] /= lx[lp[j]];
+    }
+    for (j = 0; j < n; j++) {
+        x[perm[j]] = y[j];
+    }
+}
+
+Doub scilib::SparseCholesky::logdet() {
+    Doub sum = 0.0;
+    for (Int j = 0; j < n; j++) {
+        sum += log(lx[lp[j]]);
+    }
+    return 2.0 * sum;
+}
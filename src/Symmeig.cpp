@@ -0,0 +1,385 @@
+#include <algorithm>
+#include <functional>
+#include "../include/linalg.h"
+
+// ############ Symmetric Eigendecomposition ############
+
+// Householder vector for the row segment x[0 .. len-1]: on exit x[0] = beta,
+// x[1 ..] the rest of v (v[0] = 1) and the return value tau, with
+// (I - tau v v^T) x = beta e_0.
+static Doub sy_reflector(Doub *x, const Int len) {
+    Int i;
+    Doub alpha = x[0], scale = 0.0, sum = 0.0, beta, f;
+    for (i = 1; i < len; i++) {
+        scale = MAX(scale, abs(x[i]));
+    }
+    if (scale == 0.0) {
+        return 0.0;
+    }
+    scale = MAX(scale, abs(alpha));
+    for (i = 1; i < len; i++) {
+        sum += SQR(x[i] / scale);
+    }
+    beta = -SIGN(scale * sqrt(SQR(alpha / scale) + sum), alpha);
+    f = 1.0 / (alpha - beta);
+    for (i = 1; i < len; i++) {
+        x[i] *= f;
+    }
+    x[0] = beta;
+    return (beta - alpha) / beta;
+}
+
+// Reduce the full symmetric a to tridiagonal T = Q^T a Q, d the diagonal and
+// e[j] the entry between j and j + 1. Reflector j zeroes row j beyond j + 1
+// and is left in a[j][j + 2 ..] with v[j + 1] = 1. Within a panel of nb
+// columns the two-sided updates are held in V and W (as in LAPACK's latrd),
+// so the trailing matrix is A - V W^T - W V^T and only the row being reduced
+// is brought up to date; the rank-2nb update of the trailing matrix follows
+// at the end of the panel. Symmetry makes every column a row, so all the
+// access is by rows; the products with the trailing matrix are threaded.
+static void sy_tridiag(MatDoub &a, VecDoub &d, VecDoub &e, VecDoub &tau, Int nb, const Int nthreads) {
+    Int i, j, l, p, q, k0, kb, r0, n = a.nrows();
+    Doub sum, alpha, t0, t1, t2;
+    nb = MIN(MAX(nb, 1), MAX(n - 1, 1));
+    MatDoub vt(nb, n), wt(nb, n);
+    VecDoub y(n), c1(nb), c2(nb);
+    d.resize(n);
+    e.assign(n, 0.0);
+    tau.assign(MAX(n - 1, 0), 0.0);
+
+    for (k0 = 0; k0 < n - 1; k0 += kb) {
+        kb = MIN(nb, n - 1 - k0);
+        for (p = 0; p < kb; p++) {
+            j = k0 + p;
+            Doub *aj = a[j];
+            for (q = 0; q < p; q++) {
+                t0 = wt[q][j];
+                t1 = vt[q][j];
+                for (i = j; i < n; i++) {
+                    aj[i] -= vt[q][i] * t0 + wt[q][i] * t1;
+                }
+            }
+            d[j] = aj[j];
+            tau[j] = (j + 2 < n ? sy_reflector(aj + j + 1, n - j - 1) : 0.0);
+            e[j] = aj[j + 1];
+
+            Doub *v = vt[p], *w = wt[p];
+            for (i = 0; i <= j; i++) {
+                v[i] = w[i] = 0.0;
+            }
+            v[j + 1] = 1.0;
+            for (i = j + 2; i < n; i++) {
+                v[i] = aj[i];
+            }
+            if (tau[j] == 0.0) {
+                for (i = j + 1; i < n; i++) {
+                    w[i] = 0.0;
+                }
+                continue;
+            }
+
+            // w = tau (A - V W^T - W V^T) v, then w -= (tau / 2) (w . v) v
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(l, sum, t0, t1, t2) schedule(static)
+            for (i = j + 1; i < n; i++) {
+                const Doub *ai = a[i];
+                sum = t0 = t1 = t2 = 0.0;
+                for (l = j + 1; l + 3 < n; l += 4) {
+                    sum += ai[l] * v[l];
+                    t0 += ai[l + 1] * v[l + 1];
+                    t1 += ai[l + 2] * v[l + 2];
+                    t2 += ai[l + 3] * v[l + 3];
+                }
+                for (; l < n; l++) {
+                    sum += ai[l] * v[l];
+                }
+                y[i] = (sum + t0) + (t1 + t2);
+            }
+            for (q = 0; q < p; q++) {
+                for (c1[q] = c2[q] = 0.0, i = j + 1; i < n; i++) {
+                    c1[q] += wt[q][i] * v[i];
+                    c2[q] += vt[q][i] * v[i];
+                }
+            }
+            for (q = 0; q < p; q++) {
+                for (i = j + 1; i < n; i++) {
+                    y[i] -= vt[q][i] * c1[q] + wt[q][i] * c2[q];
+                }
+            }
+            for (sum = 0.0, i = j + 1; i < n; i++) {
+                y[i] *= tau[j];
+                sum += y[i] * v[i];
+            }
+            alpha = -0.5 * tau[j] * sum;
+            for (i = j + 1; i < n; i++) {
+                w[i] = y[i] + alpha * v[i];
+            }
+        }
+
+        // A22 -= V W^T + W V^T
+        r0 = k0 + kb;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(l, q, t0, t1) schedule(static)
+        for (i = r0; i < n; i++) {
+            Doub *ai = a[i];
+            for (q = 0; q < kb; q++) {
+                const Doub *vq = vt[q], *wq = wt[q];
+                t0 = vq[i];
+                t1 = wq[i];
+                for (l = r0; l < n; l++) {
+                    ai[l] -= t0 * wq[l] + t1 * vq[l];
+                }
+            }
+        }
+    }
+    if (n > 0) {
+        d[n - 1] = a[n - 1][n - 1];
+    }
+}
+
+// Implicit QL with Wilkinson shifts on the tridiagonal (d, e), as NR's tqli.
+// With z, the rotations of each QL sweep are saved and then applied to the
+// rows of z, which are independent, in parallel; within a row they touch
+// adjacent entries only.
+static void sy_ql(VecDoub &d, VecDoub &e, MatDoub *z, const Int nthreads) {
+    Int m, l, iter, i, k, ilast, n = d.size();
+    Bool split;
+    Doub s, r, p, g, f, dd, c, b;
+    const Doub EPS = numeric_limits<Doub>::epsilon();
+    VecDoub cs(n), sn(n);
+    for (l = 0; l < n; l++) {
+        iter = 0;
+        do {
+            for (m = l; m < n - 1; m++) {
+                dd = abs(d[m]) + abs(d[m + 1]);
+                if (abs(e[m]) <= EPS * dd) {
+                    break;
+                }
+            }
+            if (m != l) {
+                if (iter++ == 30) {
+                    throw("Too many iterations in Symmeig");
+                }
+                g = (d[l + 1] - d[l]) / (2.0 * e[l]);
+                r = sqrt(g * g + 1.0);
+                g = d[m] - d[l] + e[l] / (g + SIGN(r, g));
+                s = c = 1.0;
+                p = 0.0;
+                split = false;
+                for (i = m - 1; i >= l; i--) {
+                    f = s * e[i];
+                    b = c * e[i];
+                    e[i + 1] = (r = hypot(f, g));
+                    if (r == 0.0) {
+                        d[i + 1] -= p;
+                        e[m] = 0.0;
+                        split = true;
+                        break;
+                    }
+                    s = f / r;
+                    c = g / r;
+                    g = d[i + 1] - p;
+                    r = (d[i] - g) * s + 2.0 * c * b;
+                    d[i + 1] = g + (p = s * r);
+                    g = c * r - b;
+                    cs[i] = c;
+                    sn[i] = s;
+                }
+                ilast = i + 1;
+                if (z != NULL) {
+                    MatDoub &zz = *z;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1 && zz.nrows() > 64) private(i, f) schedule(static)
+                    for (k = 0; k < zz.nrows(); k++) {
+                        Doub *zk = zz[k];
+                        for (i = m - 1; i >= ilast; i--) {
+                            f = zk[i + 1];
+                            zk[i + 1] = sn[i] * zk[i] + cs[i] * f;
+                            zk[i] = cs[i] * zk[i] - sn[i] * f;
+                        }
+                    }
+                }
+                if (split) {
+                    continue;
+                }
+                d[l] -= p;
+                e[l] = g;
+                e[m] = 0.0;
+            }
+        } while (m != l);
+    }
+}
+
+// Eigenvectors of the tridiagonal (d, e) for the eigenvalues lam by inverse
+// iteration (as LAPACK's stein): Gaussian elimination with partial pivoting
+// on T - lam I, three iterations from a fixed pseudo-random start, and
+// Gram-Schmidt against the earlier vectors of a cluster. Returned as the
+// columns of y.
+static void sy_invit(VecDoub_I &d, VecDoub_I &e, VecDoub_I &lam, MatDoub &y) {
+    Int i, j, jj, it, n = d.size(), k = lam.size(), j0 = 0;
+    Doub tnorm = 0.0, shift = 0.0, mult, sum, nrm;
+    const Doub EPS = numeric_limits<Doub>::epsilon();
+    for (i = 0; i < n; i++) {
+        tnorm = MAX(tnorm, abs(d[i]) + (i > 0 ? abs(e[i - 1]) : 0.0) + abs(e[i]));
+    }
+    const Doub sep = 1.0e-3 * tnorm, pertol = 10.0 * EPS * MAX(tnorm, 1.0e-300);
+    VecDoub u0(n), u1(n), u2(n), lm(n), x(n);
+    VecBool swp(n);
+    Ullong seed = 88172645463325252LL;
+    y.resize(n, k);
+
+    for (j = 0; j < k; j++) {
+        if (j > 0 && lam[j - 1] - lam[j] < sep) {
+            shift = MIN(lam[j], shift - pertol); // same cluster: keep the shifts apart
+        } else {
+            shift = lam[j];
+            j0 = j;
+        }
+
+        // P (T - shift I) = L U, U with two superdiagonals
+        Doub cur0 = d[0] - shift, cur1 = (n > 1 ? e[0] : 0.0);
+        for (i = 0; i < n - 1; i++) {
+            Doub r1 = d[i + 1] - shift, r2 = (i + 2 < n ? e[i + 1] : 0.0);
+            if (abs(e[i]) > abs(cur0)) {
+                swp[i] = true;
+                mult = cur0 / e[i];
+                u0[i] = e[i];
+                u1[i] = r1;
+                u2[i] = r2;
+                cur0 = cur1 - mult * r1;
+                cur1 = -mult * r2;
+            } else {
+                swp[i] = false;
+                if (cur0 == 0.0) {
+                    cur0 = pertol;
+                }
+                mult = e[i] / cur0;
+                u0[i] = cur0;
+                u1[i] = cur1;
+                u2[i] = 0.0;
+                cur0 = r1 - mult * cur1;
+                cur1 = r2;
+            }
+            lm[i] = mult;
+        }
+        u0[n - 1] = (cur0 == 0.0 ? pertol : cur0);
+
+        for (i = 0; i < n; i++) {
+            seed ^= seed >> 21; seed ^= seed << 35; seed ^= seed >> 4;
+            x[i] = 5.42101086242752217E-20 * (seed * 2685821657736338717LL) - 0.5;
+        }
+        for (it = 0; it < 3; it++) {
+            for (i = 0; i < n - 1; i++) {
+                if (swp[i]) {
+                    SWAP(x[i], x[i + 1]);
+                }
+                x[i + 1] -= lm[i] * x[i];
+            }
+            for (i = n - 1; i >= 0; i--) {
+                sum = x[i];
+                if (i + 1 < n) {
+                    sum -= u1[i] * x[i + 1];
+                }
+                if (i + 2 < n) {
+                    sum -= u2[i] * x[i + 2];
+                }
+                x[i] = sum / u0[i];
+            }
+            for (jj = j0; jj < j; jj++) {
+                for (sum = 0.0, i = 0; i < n; i++) {
+                    sum += y[i][jj] * x[i];
+                }
+                for (i = 0; i < n; i++) {
+                    x[i] -= sum * y[i][jj];
+                }
+            }
+            for (nrm = 0.0, i = 0; i < n; i++) {
+                nrm += x[i] * x[i];
+            }
+            nrm = 1.0 / sqrt(nrm);
+            for (i = 0; i < n; i++) {
+                x[i] *= nrm;
+            }
+        }
+        for (i = 0; i < n; i++) {
+            y[i][j] = x[i];
+        }
+    }
+}
+
+scilib::Symmeig::Symmeig(MatDoub_I &a, const Int opts, const Int kk, const Int nthreads, const Int nb) : n(a.nrows()), k(kk > 0 ? MIN(kk, n) : n), yesvecs(!(opts & VALUES)) {
+    Int i, j;
+    if (a.ncols() != n) {
+        throw("Symmeig: need square matrix");
+    }
+    MatDoub t(n, n);
+    for (i = 0; i < n; i++) {
+        for (j = 0; j <= i; j++) {
+            t[i][j] = t[j][i] = a[i][j];
+        }
+    }
+    VecDoub e, tau;
+    sy_tridiag(t, d, e, tau, nb, nthreads);
+
+    if (!yesvecs) {
+        sy_ql(d, e, NULL, nthreads);
+        sort(&d[0], &d[0] + n, greater<Doub>());
+        return;
+    }
+    MatDoub y;
+    if (k == n) {
+        y.assign(n, n, 0.0);
+        for (i = 0; i < n; i++) {
+            y[i][i] = 1.0;
+        }
+        sy_ql(d, e, &y, nthreads);
+        sortvecs(y);
+    } else {
+        VecDoub dt(d), et(e);
+        sy_ql(d, e, NULL, nthreads);
+        sort(&d[0], &d[0] + n, greater<Doub>());
+        VecDoub lam(k);
+        for (j = 0; j < k; j++) {
+            lam[j] = d[j];
+        }
+        sy_invit(dt, et, lam, y);
+    }
+
+    // z = Q y; reflector j acts on rows j + 1 .., i.e. column j of an
+    // (n - 1) x (n - 1) householder_qr layout
+    z = y;
+    if (n > 2) {
+        MatDoub hq(n - 1, n - 1, 0.0), zl(n - 1, k);
+        for (j = 0; j < n - 1; j++) {
+            for (i = j + 1; i < n - 1; i++) {
+                hq[i][j] = t[j][i + 1];
+            }
+        }
+        for (i = 0; i < n - 1; i++) {
+            for (j = 0; j < k; j++) {
+                zl[i][j] = y[i + 1][j];
+            }
+        }
+        householder_qmult(hq, tau, zl, 32, nthreads);
+        for (i = 0; i < n - 1; i++) {
+            for (j = 0; j < k; j++) {
+                z[i + 1][j] = zl[i][j];
+            }
+        }
+    }
+}
+
+// Sort d into decreasing order, carrying the columns of y along
+void scilib::Symmeig::sortvecs(MatDoub &y) {
+    Int i, j;
+    vector<Int> idx(n);
+    for (j = 0; j < n; j++) {
+        idx[j] = j;
+    }
+    VecDoub dd(d);
+    sort(idx.begin(), idx.end(), [&dd](Int p, Int q) { return dd[p] > dd[q]; });
+    MatDoub ys(y);
+    for (j = 0; j < n; j++) {
+        d[j] = dd[idx[j]];
+        for (i = 0; i < n; i++) {
+            y[i][j] = ys[i][idx[j]];
+        }
+    }
+}
@@ -0,0 +1,298 @@
+#include "../include/linalg.h"
+
+// ############ Structured Householder QR ############
+
+// Column k of [r; a] is nonzero only in r[k][k] and the rows of a, so the
+// reflector that zeroes it has v = e_k + (0, ..., 0, u) with u stored in
+// column k of a.
+void scilib::householder_append(MatDoub &r, MatDoub &a, VecDoub_O &tau) {
+    Int i, j, k, n = r.nrows(), mb = a.nrows();
+    Doub alpha, beta, sum, scale, tmp;
+    if (r.ncols() != n || a.ncols() != n) {
+        throw("householder_append: bad sizes");
+    }
+    tau.resize(n);
+    VecDoub s(n);
+    for (k = 0; k < n; k++) {
+        tau[k] = 0.0;
+        alpha = r[k][k];
+        scale = abs(alpha);
+        for (i = 0; i < mb; i++) {
+            scale = MAX(scale, abs(a[i][k]));
+        }
+        if (scale == 0.0) {
+            continue;
+        }
+        for (sum = 0.0, i = 0; i < mb; i++) {
+            sum += SQR(a[i][k] / scale);
+        }
+        if (sum == 0.0) {
+            continue; // column already reduced
+        }
+        beta = -SIGN(scale * sqrt(SQR(alpha / scale) + sum), alpha);
+        tau[k] = (beta - alpha) / beta;
+        tmp = 1.0 / (alpha - beta);
+        for (i = 0; i < mb; i++) {
+            a[i][k] *= tmp;
+        }
+        r[k][k] = beta;
+
+        for (j = k + 1; j < n; j++) {
+            s[j] = r[k][j];
+        }
+        for (i = 0; i < mb; i++) {
+            const Doub *ai = a[i];
+            tmp = ai[k];
+            for (j = k + 1; j < n; j++) {
+                s[j] += tmp * ai[j];
+            }
+        }
+        for (j = k + 1; j < n; j++) {
+            s[j] *= tau[k];
+            r[k][j] -= s[j];
+        }
+        for (i = 0; i < mb; i++) {
+            Doub *ai = a[i];
+            tmp = ai[k];
+            for (j = k + 1; j < n; j++) {
+                ai[j] -= tmp * s[j];
+            }
+        }
+    }
+}
+
+void scilib::householder_append_qtmult(MatDoub_I &a, VecDoub_I &tau, VecDoub_IO &c, VecDoub_IO &d) {
+    Int i, k, n = tau.size(), mb = a.nrows();
+    Doub sum;
+    for (k = 0; k < n; k++) {
+        if (tau[k] != 0.0) {
+            for (sum = c[k], i = 0; i < mb; i++) {
+                sum += a[i][k] * d[i];
+            }
+            sum *= tau[k];
+            c[k] -= sum;
+            for (i = 0; i < mb; i++) {
+                d[i] -= sum * a[i][k];
+            }
+        }
+    }
+}
+
+// ############ TSQR ############
+
+// Upper triangle of the leading n rows of a factored block.
+static void ts_uppertri(MatDoub_I &f, MatDoub &r) {
+    Int i, j, n = f.ncols();
+    r.resize(n, n);
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) {
+            r[i][j] = (j >= i ? f[i][j] : 0.0);
+        }
+    }
+}
+
+// Leaves are factored with the blocked Householder QR. At each level of the
+// tree, pairs of R factors are merged with householder_append; an odd one out
+// moves up unchanged. qtmult replays the same pairing.
+scilib::TSQR::TSQR(MatDoub_I &a, Int nblocks, Int nthreads) : m(a.nrows()), n(a.ncols()), nthreads(nthreads), sing(false) {
+    Int b, i, j, p, cnt, base;
+    if (m < n) {
+        throw("TSQR: need m >= n");
+    }
+    if (nblocks < 1) {
+        nblocks = nthreads;
+    }
+    this->nblocks = nblocks = MAX(1, MIN(nblocks, m / MAX(n, 1)));
+    start.resize(nblocks + 1);
+    for (b = 0; b <= nblocks; b++) {
+        start[b] = Int(Llong(m) * b / nblocks);
+    }
+
+    leaf.resize(nblocks);
+    leaftau.resize(nblocks);
+    vector<MatDoub> rs(nblocks), next;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(i, j) schedule(dynamic)
+    for (b = 0; b < nblocks; b++) {
+        leaf[b].resize(start[b + 1] - start[b], n);
+        for (i = start[b]; i < start[b + 1]; i++) {
+            for (j = 0; j < n; j++) {
+                leaf[b][i - start[b]][j] = a[i][j];
+            }
+        }
+        householder_qr(leaf[b], leaftau[b]);
+        ts_uppertri(leaf[b], rs[b]);
+    }
+
+    for (cnt = nblocks; cnt > 1; cnt = (cnt + 1) / 2) {
+        base = node.size();
+        node.resize(base + cnt / 2);
+        nodetau.resize(base + cnt / 2);
+        next.resize((cnt + 1) / 2);
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) schedule(dynamic)
+        for (p = 0; p < cnt / 2; p++) {
+            node[base + p] = rs[2 * p + 1];
+            householder_append(rs[2 * p], node[base + p], nodetau[base + p]);
+            next[p] = rs[2 * p];
+        }
+        if (cnt % 2 == 1) {
+            next[cnt / 2] = rs[cnt - 1];
+        }
+        rs.swap(next);
+    }
+    r = rs[0];
+    for (i = 0; i < n; i++) {
+        if (r[i][i] == 0.0) {
+            sing = true;
+        }
+    }
+}
+
+void scilib::TSQR::qtmult(VecDoub_I &b, VecDoub_O &c) {
+    Int k, i, p, cnt, base = 0;
+    if (b.size() != m) {
+        throw("TSQR: bad sizes in qtmult");
+    }
+    vector<VecDoub> cs(nblocks), next;
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(i) schedule(dynamic)
+    for (k = 0; k < nblocks; k++) {
+        VecDoub y(start[k + 1] - start[k]);
+        for (i = start[k]; i < start[k + 1]; i++) {
+            y[i - start[k]] = b[i];
+        }
+        householder_qtmult(leaf[k], leaftau[k], y);
+        cs[k].resize(n);
+        for (i = 0; i < n; i++) {
+            cs[k][i] = y[i];
+        }
+    }
+    for (cnt = nblocks; cnt > 1; cnt = (cnt + 1) / 2) {
+        next.resize((cnt + 1) / 2);
+        for (p = 0; p < cnt / 2; p++) {
+            householder_append_qtmult(node[base + p], nodetau[base + p], cs[2 * p], cs[2 * p + 1]);
+            next[p] = cs[2 * p];
+        }
+        if (cnt % 2 == 1) {
+            next[cnt / 2] = cs[cnt - 1];
+        }
+        base += cnt / 2;
+        cs.swap(next);
+    }
+    c = cs[0];
+}
+
+void scilib::TSQR::solve(VecDoub_I &b, VecDoub_O &x) {
+    Int i, j;
+    Doub sum;
+    if (sing) {
+        throw("Attempting solve in a singular TSQR");
+    }
+    VecDoub c(n);
+    qtmult(b, c);
+    x.resize(n);
+    for (i = n - 1; i >= 0; i--) {
+        for (sum = c[i], j = i + 1; j < n; j++) {
+            sum -= r[i][j] * x[j];
+        }
+        x[i] = sum / r[i][i];
+    }
+}
+
+// ############ Streaming Least Squares ############
+
+scilib::StreamQR::StreamQR(const Int n, const Doub lambda, const Doub delta) : n(n), nobs(0), lambda(lambda), r(n, n, 0.0), qtb(n, 0.0), rss(0.0) {
+    if (lambda <= 0.0 || lambda > 1.0) {
+        throw("StreamQR: need 0 < lambda <= 1");
+    }
+    for (Int i = 0; i < n; i++) {
+        r[i][i] = sqrt(delta);
+    }
+}
+
+// Age the fit by one row, then rotate row k of R against the new row to zero
+// its k-th entry. What is left of b is the residual of the new row.
+void scilib::StreamQR::add(VecDoub_I &a, const Doub b) {
+    Int j, k;
+    Doub c, s, h, y, w, beta = b, sl = sqrt(lambda);
+    if (a.size() != n) {
+        throw("StreamQR: bad sizes in add");
+    }
+    VecDoub v(a);
+    if (lambda != 1.0) {
+        for (k = 0; k < n; k++) {
+            Doub *rk = r[k];
+            for (j = k; j < n; j++) {
+                rk[j] *= sl;
+            }
+            qtb[k] *= sl;
+        }
+        rss *= lambda;
+    }
+    for (k = 0; k < n; k++) {
+        if (v[k] == 0.0) {
+            continue;
+        }
+        Doub *rk = r[k];
+        h = sqrt(SQR(rk[k]) + SQR(v[k]));
+        c = rk[k] / h;
+        s = v[k] / h;
+        rk[k] = h;
+        for (j = k + 1; j < n; j++) {
+            y = rk[j];
+            w = v[j];
+            rk[j] = c * y + s * w;
+            v[j] = c * w - s * y;
+        }
+        y = qtb[k];
+        qtb[k] = c * y + s * beta;
+        beta = c * beta - s * y;
+    }
+    rss += SQR(beta);
+    nobs++;
+}
+
+// The block is weighted row by row to match adding its rows one at a time.
+void scilib::StreamQR::add(MatDoub_I &a, VecDoub_I &b) {
+    Int i, j, mb = a.nrows();
+    Doub f, sl = sqrt(lambda);
+    if (a.ncols() != n || b.size() != mb) {
+        throw("StreamQR: bad sizes in add");
+    }
+    MatDoub v(a);
+    VecDoub tau, d(b);
+    if (lambda != 1.0) {
+        for (f = 1.0, i = mb - 1; i >= 0; i--, f *= sl) {
+            for (j = 0; j < n; j++) {
+                v[i][j] *= f;
+            }
+            d[i] *= f;
+        }
+        for (i = 0; i < n; i++) {
+            for (j = i; j < n; j++) {
+                r[i][j] *= f;
+            }
+            qtb[i] *= f;
+        }
+        rss *= SQR(f);
+    }
+    householder_append(r, v, tau);
+    householder_append_qtmult(v, tau, qtb, d);
+    for (i = 0; i < mb; i++) {
+        rss += SQR(d[i]);
+    }
+    nobs += mb;
+}
+
+void scilib::StreamQR::solve(VecDoub_O &x) {
+    Int i, j;
+    Doub sum;
+    x.resize(n);
+    for (i = n - 1; i >= 0; i--) {
+        if (r[i][i] == 0.0) {
+            throw("Attempting solve in a singular StreamQR");
+        }
+        for (sum = qtb[i], j = i + 1; j < n; j++) {
+            sum -= r[i][j] * x[j];
+        }
+        x[i] = sum / r[i][i];
+    }
+}
@@ -0,0 +1,84 @@
+#include "../include/linalg.h"
+
+// ############ Tridiagonal Systems ############
+
+// a: sub-diagonal (a[0] unused), b: diagonal, c: super-diagonal (c[n-1]
+// unused). Thomas algorithm without pivoting.
+void scilib::tridag(VecDoub_I &a, VecDoub_I &b, VecDoub_I &c, VecDoub_I &r, VecDoub_O &u) {
+    Int j, n = a.size();
+    Doub bet;
+    VecDoub gam(n);
+    if (b[0] == 0.0) {
+        throw("Error 1 in tridag");
+    }
+    u[0] = r[0] / (bet = b[0]);
+    for (j = 1; j < n; j++) {
+        gam[j] = c[j - 1] / bet;
+        bet = b[j] - a[j] * gam[j];
+        if (bet == 0.0) {
+            throw("Error 2 in tridag");
+        }
+        u[j] = (r[j] - a[j] * u[j - 1]) / bet;
+    }
+    for (j = n - 2; j >= 0; j--) {
+        u[j] -= gam[j + 1] * u[j + 1];
+    }
+}
+
+// Cyclic reduction. Level s eliminates the odd multiples of s from the
+// equations at i = 2s-1, 4s-1, ..., leaving a system of half the size; the
+// single equation left at the top is solved directly and the eliminated
+// unknowns are recovered on the way back down. Every equation on a level is
+// independent, so each level is a parallel loop. Same conventions as tridag;
+// intended for diagonally dominant systems, as no pivoting is done.
+void scilib::tridag_cr(VecDoub_I &a, VecDoub_I &b, VecDoub_I &c, VecDoub_I &r, VecDoub_O &u, const Int nthreads) {
+    Int i, s, n = a.size();
+    Doub alpha, gamma;
+    Bool ok = true;
+    if (n == 0) {
+        return;
+    }
+    VecDoub aa(a), bb(b), cc(c), rr(r);
+    aa[0] = 0.0;
+    cc[n - 1] = 0.0;
+
+    for (s = 1; 2 * s <= n; s *= 2) {
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1) private(alpha, gamma) reduction(&&: ok)
+        for (i = 2 * s - 1; i < n; i += 2 * s) {
+            if (bb[i - s] == 0.0 || (i + s < n && bb[i + s] == 0.0)) {
+                ok = false;
+                continue;
+            }
+            alpha = -aa[i] / bb[i - s];
+            gamma = (i + s < n ? -cc[i] / bb[i + s] : 0.0);
+            bb[i] += alpha * cc[i - s];
+            rr[i] += alpha * rr[i - s];
+            aa[i] = alpha * aa[i - s];
+            if (i + s < n) {
+                bb[i] += gamma * aa[i + s];
+                rr[i] += gamma * rr[i + s];
+                cc[i] = gamma * cc[i + s];
+            } else {
+                cc[i] = 0.0;
+            }
+        }
+    }
+    if (!ok || bb[s - 1] == 0.0) {
+        throw("Error in tridag_cr");
+    }
+    u[s - 1] = rr[s - 1] / bb[s - 1];
+
+    for (s /= 2; s >= 1; s /= 2) {
+#pragma omp parallel for num_threads(nthreads) if(nthreads > 1)
+        for (i = s - 1; i < n; i += 2 * s) {
+            Doub sum = rr[i];
+            if (i - s >= 0) {
+                sum -= aa[i] * u[i - s];
+            }
+            if (i + s < n) {
+                sum -= cc[i] * u[i + s];
+            }
+            u[i] = sum / bb[i];
+        }
+    }
+}
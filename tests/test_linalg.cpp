@@ -0,0 +1,1365 @@
+#include "test_utils.h"
+#include "../include/linalg.h"
+#include "../include/eft.h"
+#include "../include/sparse.h"
+#include "../include/krylov.h"
+
+// UTILS
+
+void randomMatrix(MatDoub_O& a, unsigned int seed = 1) {
+    srand(seed);
+    for (int i = 0; i < a.nrows(); i++) {
+        for (int j = 0; j < a.ncols(); j++) {
+            a[i][j] = rand() / (double)RAND_MAX - 0.5;
+        }
+    }
+}
+
+Doub maxAbsDiff(MatDoub_I& a, MatDoub_I& b) {
+    Doub diff = 0.0;
+    for (int i = 0; i < a.nrows(); i++) {
+        for (int j = 0; j < a.ncols(); j++) {
+            diff = MAX(diff, abs(a[i][j] - b[i][j]));
+        }
+    }
+    return diff;
+}
+
+Doub residual(MatDoub_I& a, VecDoub_I& x, VecDoub_I& b) {
+    Doub res = 0.0;
+    for (int i = 0; i < a.nrows(); i++) {
+        Doub sum = -b[i];
+        for (int j = 0; j < a.ncols(); j++) {
+            sum += a[i][j] * x[j];
+        }
+        res = MAX(res, abs(sum));
+    }
+    return res;
+}
+
+// LU
+
+void testLUdcmpBlocked() {
+    int n = 150;
+    MatDoub a(n, n);
+    randomMatrix(a);
+
+    scilib::LUdcmp unblocked(a, n);
+    scilib::LUdcmp blocked(a, 16);
+
+    bool samePivots = true;
+    for (int i = 0; i < n; i++) {
+        samePivots = samePivots && unblocked.indx[i] == blocked.indx[i];
+    }
+
+    VecDoub b(n), x(n);
+    for (int i = 0; i < n; i++) {
+        b[i] = 1.0;
+    }
+    blocked.solve(b, x);
+
+    printTestResult("Blocked LU Decomposition", samePivots && unblocked.d == blocked.d && maxAbsDiff(unblocked.lu, blocked.lu) == 0.0 && residual(a, x, b) < 1e-10);
+}
+
+void testLUdcmpParallel() {
+    int n = 200;
+    MatDoub a(n, n);
+    randomMatrix(a, 2);
+
+    scilib::LUdcmp serial(a, 32, 1);
+    scilib::LUdcmp parallel(a, 32, 4);
+
+    bool samePivots = true;
+    for (int i = 0; i < n; i++) {
+        samePivots = samePivots && serial.indx[i] == parallel.indx[i];
+    }
+
+    printTestResult("Parallel LU Decomposition", samePivots && serial.d == parallel.d && maxAbsDiff(serial.lu, parallel.lu) == 0.0);
+}
+
+void testLUdcmpMultiSolve() {
+    int n = 60, m = 70;
+    MatDoub a(n, n), b(n, m), x(n, m);
+    randomMatrix(a, 3);
+    randomMatrix(b, 4);
+
+    scilib::LUdcmp lu(a, 16, 2);
+    lu.solve(b, x);
+
+    Doub diff = 0.0;
+    VecDoub bj(n), xj(n);
+    for (int j = 0; j < m; j++) {
+        for (int i = 0; i < n; i++) {
+            bj[i] = b[i][j];
+        }
+        lu.solve(bj, xj);
+        for (int i = 0; i < n; i++) {
+            diff = MAX(diff, abs(xj[i] - x[i][j]));
+        }
+    }
+
+    printTestResult("LU Multiple Right-Hand Sides", diff < 1e-10);
+}
+
+void testLUdcmpInverse() {
+    int n = 90;
+    MatDoub a(n, n), ainv;
+    randomMatrix(a, 5);
+
+    scilib::LUdcmp lu(a, 16, 2);
+    lu.inverse(ainv);
+
+    Doub err = 0.0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            Doub sum = (i == j ? -1.0 : 0.0);
+            for (int k = 0; k < n; k++) {
+                sum += a[i][k] * ainv[k][j];
+            }
+            err = MAX(err, abs(sum));
+        }
+    }
+
+    printTestResult("LU Inverse", err < 1e-10);
+}
+
+// Cholesky
+
+void testCholesky() {
+    int n = 100;
+    MatDoub g(n, n), a(n, n, 0.0), ainv;
+    randomMatrix(g, 6);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            for (int k = 0; k < n; k++) {
+                a[i][j] += g[i][k] * g[j][k];
+            }
+        }
+        a[i][i] += 1.0;
+    }
+
+    scilib::Cholesky chol(a, 16, 2);
+    scilib::LUdcmp lu(a);
+
+    VecDoub b(n), x(n);
+    for (int i = 0; i < n; i++) {
+        b[i] = 1.0;
+    }
+    chol.solve(b, x);
+    chol.inverse(ainv);
+
+    Doub err = 0.0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            Doub sum = (i == j ? -1.0 : 0.0);
+            for (int k = 0; k < n; k++) {
+                sum += a[i][k] * ainv[k][j];
+            }
+            err = MAX(err, abs(sum));
+        }
+    }
+
+    bool logdetOk = abs(chol.logdet() - log(abs(lu.det()))) < 1e-8;
+    printTestResult("Cholesky Decomposition", residual(a, x, b) < 1e-10 && err < 1e-10 && logdetOk);
+}
+
+void testMixedLUdcmp() {
+    int n = 120;
+    MatDoub a(n, n);
+    randomMatrix(a, 7);
+
+    scilib::MixedLUdcmp mixed(a, 32);
+    scilib::LUdcmp lu(a);
+
+    VecDoub b(n), x(n), xd(n);
+    for (int i = 0; i < n; i++) {
+        b[i] = sin(Doub(i));
+    }
+    mixed.solve(b, x);
+    lu.solve(b, xd);
+
+    Doub diff = 0.0;
+    for (int i = 0; i < n; i++) {
+        diff = MAX(diff, abs(x[i] - xd[i]));
+    }
+
+    bool ok = mixed.its >= 0 && diff < 1e-10 && residual(a, x, b) < 1e-12;
+
+    // in-place solve, and the matrix overload stops at the same accuracy
+    VecDoub y(b);
+    MatDoub bm(n, 2), xm(n, 2);
+    for (int i = 0; i < n; i++) {
+        bm[i][0] = bm[i][1] = b[i];
+    }
+    mixed.solve(y, y);
+    mixed.solve(bm, xm);
+    Doub mdiff = 0.0;
+    for (int i = 0; i < n; i++) {
+        mdiff = MAX(mdiff, MAX(abs(y[i] - x[i]), abs(xm[i][1] - x[i])));
+    }
+    ok = ok && mdiff < 1e-13;
+
+    // singular in single precision: the fallback is built by the constructor
+    MatDoub s(a);
+    for (int j = 0; j < n; j++) {
+        s[n - 1][j] = s[0][j] + s[1][j];
+    }
+    scilib::MixedLUdcmp sing(s, 32);
+    ok = ok && sing.full != NULL;
+    printTestResult("Mixed-Precision LU", ok);
+}
+
+void testCompensatedDot() {
+    VecDoub x(9), y(9, 1.0);
+    for (int i = 0; i < 9; i++) {
+        x[i] = 0.0;
+    }
+    x[0] = 1e16;
+    x[3] = 1.0;
+    x[8] = -1e16;
+
+    Doub naive = 0.0;
+    for (int i = 0; i < 9; i++) {
+        naive += x[i] * y[i];
+    }
+
+    bool ok = naive == 0.0 && scilib::dot2(&x[0], &y[0], 9) == 1.0;
+
+    // mprove on a scaled Hilbert matrix (cond ~ 1e10) with integer entries,
+    // so b = a xt is exact and xt is the true solution
+    int n = 8;
+    MatDoub a(n, n);
+    VecDoub xt(n), b(n), xs(n);
+    for (int i = 0; i < n; i++) {
+        xt[i] = (i % 2 ? 1.0 : -2.0);
+        for (int j = 0; j < n; j++) {
+            a[i][j] = 360360.0 / (i + j + 1);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        b[i] = 0.0;
+        for (int j = 0; j < n; j++) {
+            b[i] += a[i][j] * xt[j];
+        }
+    }
+    scilib::LUdcmp lu(a);
+    lu.solve(b, xs);
+    Doub err0 = 0.0, err = 0.0;
+    for (int i = 0; i < n; i++) {
+        err0 = MAX(err0, abs(xs[i] - xt[i]));
+    }
+    lu.mprove(b, xs);
+    lu.mprove(b, xs);
+    for (int i = 0; i < n; i++) {
+        err = MAX(err, abs(xs[i] - xt[i]));
+    }
+    ok = ok && err0 > 1e-10 && err < 1e-14;
+    printTestResult("Compensated Dot Product", ok);
+}
+
+// Banded
+
+void testBandedSolvers() {
+    int n = 80, m1 = 2, m2 = 3;
+    MatDoub a(n, n, 0.0), band(n, m1 + m2 + 1, 0.0);
+    srand(8);
+    for (int i = 0; i < n; i++) {
+        for (int j = MAX(0, i - m1); j <= MIN(n - 1, i + m2); j++) {
+            a[i][j] = rand() / (double)RAND_MAX - 0.5;
+            band[i][m1 + j - i] = a[i][j];
+        }
+    }
+    scilib::Bandec bandec(band, m1, m2);
+
+    VecDoub b(n), x(n);
+    for (int i = 0; i < n; i++) {
+        b[i] = cos(Doub(i));
+    }
+    bandec.solve(b, x);
+
+    VecDoub sub(n), diag(n), sup(n), u(n), ucr(n);
+    for (int i = 0; i < n; i++) {
+        sub[i] = -1.0;
+        diag[i] = 4.0;
+        sup[i] = -1.0;
+    }
+    scilib::tridag(sub, diag, sup, b, u);
+    scilib::tridag_cr(sub, diag, sup, b, ucr, 2);
+
+    Doub diff = 0.0;
+    for (int i = 0; i < n; i++) {
+        diff = MAX(diff, abs(u[i] - ucr[i]));
+    }
+
+    printTestResult("Banded and Tridiagonal Solvers", residual(a, x, b) < 1e-10 && diff < 1e-12);
+}
+
+// Sparse
+
+scilib::SparseMat laplacian2d(int g) {
+    int n = g * g, nt = n + 4 * g * (g - 1), k = 0;
+    VecInt ti(nt), tj(nt);
+    VecDoub tv(nt);
+    for (int x = 0; x < g; x++) {
+        for (int y = 0; y < g; y++) {
+            int i = x * g + y;
+            int nbrs[4] = {x > 0 ? i - g : -1, x < g - 1 ? i + g : -1, y > 0 ? i - 1 : -1, y < g - 1 ? i + 1 : -1};
+            ti[k] = tj[k] = i;
+            tv[k++] = 4.1;
+            for (int j = 0; j < 4; j++) {
+                if (nbrs[j] >= 0) {
+                    ti[k] = i;
+                    tj[k] = nbrs[j];
+                    tv[k++] = -1.0;
+                }
+            }
+        }
+    }
+    return scilib::SparseMat(n, n, ti, tj, tv);
+}
+
+void testSparseCholesky() {
+    scilib::SparseMat a = laplacian2d(20);
+    int n = a.nrows;
+
+    scilib::SparseCholesky ordered(a);
+    scilib::SparseCholesky natural(a, false);
+
+    VecDoub b(n), x(n), ax(n);
+    for (int i = 0; i < n; i++) {
+        b[i] = sin(Doub(i));
+    }
+    ordered.solve(b, x);
+    a.ax(x, ax, 2);
+
+    Doub res = 0.0;
+    for (int i = 0; i < n; i++) {
+        res = MAX(res, abs(ax[i] - b[i]));
+    }
+
+    bool lessFill = ordered.lp[n] < natural.lp[n];
+    bool ok = res < 1e-12 && lessFill && abs(ordered.logdet() - natural.logdet()) < 1e-8;
+
+    // a larger grid, where the banded natural order fills in about n^1.5
+    scilib::SparseMat big = laplacian2d(100);
+    int nb = big.nrows;
+    scilib::SparseCholesky bigord(big), bignat(big, false);
+    VecDoub bb(nb), xb(nb), axb(nb);
+    for (int i = 0; i < nb; i++) {
+        bb[i] = cos(Doub(i));
+    }
+    bigord.solve(bb, xb);
+    big.ax(xb, axb);
+    res = 0.0;
+    for (int i = 0; i < nb; i++) {
+        res = MAX(res, abs(axb[i] - bb[i]));
+    }
+    ok = ok && res < 1e-12 && 4 * bigord.lp[nb] < bignat.lp[nb];
+    printTestResult("Sparse Cholesky", ok);
+}
+
+void testKrylov() {
+    scilib::SparseMat a = laplacian2d(20);
+    int n = a.nrows;
+    VecDoub b(n), ax(n);
+    for (int i = 0; i < n; i++) {
+        b[i] = sin(Doub(i));
+    }
+
+    scilib::ILU0 ilu(a);
+    scilib::Krylov plain(scilib::linop(a, 2));
+    scilib::Krylov pcg(scilib::linop(a, 2), ilu.op(), 2);
+    scilib::Krylov jac(scilib::linop(a), scilib::jacobi(a));
+    scilib::Krylov gm(scilib::linop(a), ilu.op());
+
+    VecDoub x1(n, 0.0), x2(n, 0.0), x3(n, 0.0), x4(n, 0.0);
+    plain.cg(b, x1);
+    pcg.cg(b, x2);
+    jac.bicgstab(b, x3);
+    gm.gmres(b, x4, 20);
+
+    Doub res = 0.0, gres = 0.0;
+    a.ax(x2, ax);
+    for (int i = 0; i < n; i++) {
+        res = MAX(res, abs(ax[i] - b[i]));
+    }
+    a.ax(x4, ax);
+    for (int i = 0; i < n; i++) {
+        gres = MAX(gres, abs(ax[i] - b[i]));
+    }
+
+    bool ok = plain.converged && pcg.converged && jac.converged && gm.converged && res < 1e-8 && gres < 1e-8;
+    ok = ok && pcg.iter < plain.iter && plain.err < 1e-9 && jac.err < 1e-9 && pcg.err < 1e-9 && gm.err < 1e-9;
+
+    // b = 0 is solved exactly by the starting guess
+    VecDoub zero(n, 0.0), y1(n, 0.0), y2(n, 0.0);
+    plain.cg(zero, y1);
+    ok = ok && plain.converged && plain.iter == 0 && y1[0] == 0.0;
+    jac.bicgstab(zero, y2);
+    ok = ok && jac.converged && jac.iter == 0 && y2[0] == 0.0;
+    plain.cg(b, x2);
+    ok = ok && plain.converged && plain.iter == 0;
+
+    // a singular diagonal block throws without leaking the blocks before it
+    MatDoub s(4, 4, 0.0);
+    s[0][0] = s[1][1] = 1.0;
+    bool threw = false;
+    try {
+        scilib::BlockJacobi bj(s, 2);
+    } catch (...) {
+        threw = true;
+    }
+    ok = ok && threw;
+    printTestResult("Krylov solvers", ok);
+}
+
+void testQRdcmpBlocked() {
+    int n = 150;
+    MatDoub a(n, n);
+    randomMatrix(a, 11);
+
+    scilib::QRdcmp unblocked(a, n);
+    scilib::QRdcmp blocked(a, 16, 2);
+
+    // Q^T A = R and Q Q^T = I
+    Doub qtaErr = 0.0, orthErr = 0.0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            Doub qta = 0.0, qqt = 0.0;
+            for (int k = 0; k < n; k++) {
+                qta += blocked.qt[i][k] * a[k][j];
+                qqt += blocked.qt[i][k] * blocked.qt[j][k];
+            }
+            qtaErr = MAX(qtaErr, abs(qta - blocked.r[i][j]));
+            orthErr = MAX(orthErr, abs(qqt - (i == j ? 1.0 : 0.0)));
+        }
+    }
+
+    VecDoub b(n), x(n);
+    for (int i = 0; i < n; i++) {
+        b[i] = cos(Doub(i));
+    }
+    blocked.solve(b, x);
+
+    bool ok = qtaErr < 1e-12 && orthErr < 1e-12 && residual(a, x, b) < 1e-10;
+    ok = ok && maxAbsDiff(blocked.r, unblocked.r) < 1e-12 && maxAbsDiff(blocked.qt, unblocked.qt) < 1e-12;
+    printTestResult("Blocked QR Decomposition", ok);
+}
+
+void testQRdcmpImplicit() {
+    int n = 120;
+    MatDoub a(n, n);
+    randomMatrix(a, 12);
+
+    scilib::QRdcmp explicitq(a, 16);
+    scilib::QRdcmp implicitq(a, 16, 1, false);
+
+    VecDoub b(n), x1(n), x2(n), qtb(n), qqtb(n);
+    for (int i = 0; i < n; i++) {
+        b[i] = cos(Doub(i));
+    }
+    explicitq.solve(b, x1);
+    implicitq.solve(b, x2);
+    implicitq.qtmult(b, qtb);
+    implicitq.qmult(qtb, qqtb);
+
+    Doub diff = 0.0, roundTrip = 0.0;
+    for (int i = 0; i < n; i++) {
+        diff = MAX(diff, abs(x1[i] - x2[i]));
+        roundTrip = MAX(roundTrip, abs(qqtb[i] - b[i]));
+    }
+
+    bool ok = implicitq.implicitq && implicitq.qt.nrows() == 0 && diff < 1e-10 && roundTrip < 1e-13;
+    implicitq.formqt();
+    ok = ok && !implicitq.implicitq && maxAbsDiff(implicitq.qt, explicitq.qt) < 1e-13 && maxAbsDiff(implicitq.r, explicitq.r) < 1e-13;
+    printTestResult("Implicit-Q QR Decomposition", ok);
+}
+
+void testTSQR() {
+    int m = 2000, n = 12;
+    MatDoub a(m, n);
+    randomMatrix(a, 13);
+    VecDoub b(m);
+    for (int i = 0; i < m; i++) {
+        b[i] = sin(0.01 * i) + a[i][0] - 2.0 * a[i][n - 1];
+    }
+
+    // reference from the normal equations
+    MatDoub ata(n, n, 0.0);
+    VecDoub atb(n, 0.0), xref(n);
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            atb[j] += a[i][j] * b[i];
+            for (int k = 0; k < n; k++) {
+                ata[j][k] += a[i][j] * a[i][k];
+            }
+        }
+    }
+    scilib::Cholesky chol(ata);
+    chol.solve(atb, xref);
+
+    scilib::TSQR single(a, 1);
+    scilib::TSQR tree(a, 7, 2);
+    VecDoub x1(n), x2(n), x3(n);
+    single.solve(b, x1);
+    tree.solve(b, x2);
+
+    // streamed in uneven blocks
+    scilib::StreamQR stream(n);
+    for (int r0 = 0; r0 < m; ) {
+        int mb = MIN(1 + r0 % 37, m - r0);
+        MatDoub blk(mb, n);
+        VecDoub bb(mb);
+        for (int i = 0; i < mb; i++) {
+            for (int j = 0; j < n; j++) {
+                blk[i][j] = a[r0 + i][j];
+            }
+            bb[i] = b[r0 + i];
+        }
+        stream.add(blk, bb);
+        r0 += mb;
+    }
+    stream.solve(x3);
+
+    Doub rss = 0.0;
+    for (int i = 0; i < m; i++) {
+        Doub sum = -b[i];
+        for (int j = 0; j < n; j++) {
+            sum += a[i][j] * x1[j];
+        }
+        rss += sum * sum;
+    }
+
+    Doub diff = 0.0;
+    for (int j = 0; j < n; j++) {
+        diff = MAX(diff, MAX(abs(x1[j] - xref[j]), MAX(abs(x2[j] - xref[j]), abs(x3[j] - xref[j]))));
+    }
+    bool ok = diff < 1e-10 && stream.nobs == m && abs(stream.rss - rss) < 1e-8 * rss;
+    printTestResult("TSQR Least Squares", ok);
+}
+
+// max |Q R - A|, with R required to be upper-triangular
+Doub qrError(scilib::QRdcmp& qr, MatDoub_I& a) {
+    Doub err = 0.0;
+    for (int i = 0; i < qr.m; i++) {
+        for (int j = 0; j < qr.n; j++) {
+            Doub sum = 0.0;
+            for (int k = 0; k < qr.m; k++) {
+                sum += qr.qt[k][i] * qr.r[k][j];
+            }
+            err = MAX(err, abs(sum - a[i][j]));
+            if (i > j) {
+                err = MAX(err, abs(qr.r[i][j]));
+            }
+        }
+    }
+    return err;
+}
+
+void testQRdcmpUpdates() {
+    int m = 40, n = 30, k = 3;
+    MatDoub a(m, n);
+    randomMatrix(a, 14);
+    scilib::QRdcmp qr(a, 8);
+    bool ok = qrError(qr, a) < 1e-12;
+
+    // column inserted at 5, then column 0 dropped
+    VecDoub col(m);
+    MatDoub a1(m, n + 1), a2(m, n);
+    for (int i = 0; i < m; i++) {
+        col[i] = sin(Doub(i));
+        for (int j = 0; j <= n; j++) {
+            a1[i][j] = (j < 5 ? a[i][j] : (j == 5 ? col[i] : a[i][j - 1]));
+        }
+        for (int j = 0; j < n; j++) {
+            a2[i][j] = a1[i][j + 1];
+        }
+    }
+    qr.insertcol(5, col);
+    ok = ok && qr.n == n + 1 && qrError(qr, a1) < 1e-12;
+    qr.deletecol(0);
+    ok = ok && qr.n == n && qrError(qr, a2) < 1e-12;
+
+    // row inserted at 7, then row 20 dropped
+    VecDoub row(n);
+    MatDoub a3(m + 1, n), a4(m, n);
+    for (int j = 0; j < n; j++) {
+        row[j] = cos(Doub(j));
+    }
+    for (int i = 0; i <= m; i++) {
+        for (int j = 0; j < n; j++) {
+            a3[i][j] = (i < 7 ? a2[i][j] : (i == 7 ? row[j] : a2[i - 1][j]));
+        }
+    }
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            a4[i][j] = a3[i < 20 ? i : i + 1][j];
+        }
+    }
+    qr.insertrow(7, row);
+    ok = ok && qr.m == m + 1 && qrError(qr, a3) < 1e-12;
+    qr.deleterow(20);
+    ok = ok && qr.m == m && qrError(qr, a4) < 1e-12;
+
+    // rank-k update A + X Y^T, passed as Q^T X
+    MatDoub x(m, k), y(n, k), qtx(m, k, 0.0);
+    randomMatrix(x, 15);
+    randomMatrix(y, 16);
+    for (int i = 0; i < m; i++) {
+        for (int c = 0; c < k; c++) {
+            for (int l = 0; l < m; l++) {
+                qtx[i][c] += qr.qt[i][l] * x[l][c];
+            }
+        }
+        for (int j = 0; j < n; j++) {
+            for (int c = 0; c < k; c++) {
+                a4[i][j] += x[i][c] * y[j][c];
+            }
+        }
+    }
+    qr.update(qtx, y);
+    ok = ok && qrError(qr, a4) < 1e-12;
+
+    // least-squares solve agrees with a fresh factorization
+    VecDoub b(m), x1(n), x2(n);
+    for (int i = 0; i < m; i++) {
+        b[i] = sin(0.3 * i);
+    }
+    scilib::QRdcmp fresh(a4);
+    qr.solve(b, x1);
+    fresh.solve(b, x2);
+    for (int j = 0; j < n; j++) {
+        ok = ok && abs(x1[j] - x2[j]) < 1e-10;
+    }
+    printTestResult("QR Updates", ok);
+}
+
+void testStreamQRForgetting() {
+    int m = 300, n = 6;
+    Doub lambda = 0.98, delta = 0.5;
+    MatDoub a(m, n);
+    randomMatrix(a, 17);
+    VecDoub b(m);
+    for (int i = 0; i < m; i++) {
+        b[i] = a[i][1] - a[i][4] + 0.1 * sin(Doub(i)) + (i > m / 2 ? a[i][0] : 0.0);
+    }
+
+    // reference: weighted ridge normal equations
+    MatDoub ata(n, n, 0.0);
+    VecDoub atb(n, 0.0), xref(n);
+    for (int j = 0; j < n; j++) {
+        ata[j][j] = delta * pow(lambda, m);
+    }
+    for (int i = 0; i < m; i++) {
+        Doub wt = pow(lambda, m - 1 - i);
+        for (int j = 0; j < n; j++) {
+            atb[j] += wt * a[i][j] * b[i];
+            for (int k = 0; k < n; k++) {
+                ata[j][k] += wt * a[i][j] * a[i][k];
+            }
+        }
+    }
+    scilib::Cholesky chol(ata);
+    chol.solve(atb, xref);
+
+    scilib::StreamQR rows(n, lambda, delta), blocks(n, lambda, delta);
+    for (int i = 0; i < m; i++) {
+        VecDoub ai(n);
+        for (int j = 0; j < n; j++) {
+            ai[j] = a[i][j];
+        }
+        rows.add(ai, b[i]);
+    }
+    for (int r0 = 0; r0 < m; r0 += 25) {
+        MatDoub blk(25, n);
+        VecDoub bb(25);
+        for (int i = 0; i < 25; i++) {
+            for (int j = 0; j < n; j++) {
+                blk[i][j] = a[r0 + i][j];
+            }
+            bb[i] = b[r0 + i];
+        }
+        blocks.add(blk, bb);
+    }
+
+    VecDoub x1(n), x2(n);
+    rows.solve(x1);
+    blocks.solve(x2);
+    bool ok = rows.nobs == m && blocks.nobs == m && abs(rows.rss - blocks.rss) < 1e-10;
+    for (int j = 0; j < n; j++) {
+        ok = ok && abs(x1[j] - xref[j]) < 1e-10 && abs(x2[j] - xref[j]) < 1e-10;
+    }
+    printTestResult("Streaming QR with Forgetting", ok);
+}
+
+void testQRPdcmp() {
+    int m = 60, n = 40, r = 25;
+    MatDoub x(m, r), y(r, n), a(m, n, 0.0);
+    randomMatrix(x, 18);
+    randomMatrix(y, 19);
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            for (int k = 0; k < r; k++) {
+                a[i][j] += x[i][k] * y[k][j];
+            }
+        }
+    }
+
+    scilib::QRPdcmp qrp(a, 8);
+    bool ok = qrp.rank() == r;
+    for (int k = 1; k < n; k++) {
+        ok = ok && abs(qrp.qr[k][k]) <= abs(qrp.qr[k - 1][k - 1]) * (1.0 + 1e-12);
+    }
+
+    // A P = Q R, column by column
+    Doub err = 0.0;
+    VecDoub col(m);
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < m; i++) {
+            col[i] = (i <= j ? qrp.qr[i][j] : 0.0);
+        }
+        scilib::householder_qmult(qrp.qr, qrp.tau, col);
+        for (int i = 0; i < m; i++) {
+            err = MAX(err, abs(col[i] - a[i][qrp.perm[j]]));
+        }
+    }
+
+    // A N = 0 with N^T N = I, and A = U U^T A for the range U
+    MatDoub nul = qrp.nullspace(), ran = qrp.range();
+    ok = ok && nul.ncols() == n - r && ran.ncols() == r;
+    for (int j = 0; j < nul.ncols(); j++) {
+        for (int i = 0; i < m; i++) {
+            Doub sum = 0.0;
+            for (int k = 0; k < n; k++) {
+                sum += a[i][k] * nul[k][j];
+            }
+            err = MAX(err, abs(sum));
+        }
+        for (int l = 0; l < nul.ncols(); l++) {
+            Doub sum = 0.0;
+            for (int k = 0; k < n; k++) {
+                sum += nul[k][j] * nul[k][l];
+            }
+            err = MAX(err, abs(sum - (j == l ? 1.0 : 0.0)));
+        }
+    }
+    for (int j = 0; j < n; j++) {
+        VecDoub proj(r, 0.0);
+        for (int k = 0; k < r; k++) {
+            for (int i = 0; i < m; i++) {
+                proj[k] += ran[i][k] * a[i][j];
+            }
+        }
+        for (int i = 0; i < m; i++) {
+            Doub sum = 0.0;
+            for (int k = 0; k < r; k++) {
+                sum += ran[i][k] * proj[k];
+            }
+            err = MAX(err, abs(sum - a[i][j]));
+        }
+    }
+
+    // basic solution satisfies the normal equations
+    VecDoub b(m), xs(n), res(m);
+    for (int i = 0; i < m; i++) {
+        b[i] = sin(Doub(i));
+    }
+    qrp.solve(b, xs);
+    for (int i = 0; i < m; i++) {
+        res[i] = -b[i];
+        for (int j = 0; j < n; j++) {
+            res[i] += a[i][j] * xs[j];
+        }
+    }
+    for (int j = 0; j < n; j++) {
+        Doub sum = 0.0;
+        for (int i = 0; i < m; i++) {
+            sum += a[i][j] * res[i];
+        }
+        err = MAX(err, abs(sum));
+    }
+    printTestResult("Column-Pivoted QR", ok && err < 1e-10);
+}
+
+// max |u diag(w) v^T - a|
+Doub svdError(scilib::SVD& svd, MatDoub_I& a) {
+    Doub err = 0.0;
+    for (int i = 0; i < a.nrows(); i++) {
+        for (int j = 0; j < a.ncols(); j++) {
+            Doub sum = 0.0;
+            for (int k = 0; k < svd.w.size(); k++) {
+                sum += svd.u[i][k] * svd.w[k] * svd.v[j][k];
+            }
+            err = MAX(err, abs(sum - a[i][j]));
+        }
+    }
+    return err;
+}
+
+void testSVDModes() {
+    int m = 300, n = 20;
+    MatDoub a(m, n);
+    randomMatrix(a, 20);
+
+    scilib::SVD full(a);
+    scilib::SVD values(a, scilib::SVD::VALUES);
+    scilib::SVD thin(a, scilib::SVD::THIN, 2);
+    scilib::SVD both(a, scilib::SVD::VALUES | scilib::SVD::THIN);
+
+    Doub diff = 0.0;
+    for (int j = 0; j < n; j++) {
+        diff = MAX(diff, abs(values.w[j] - full.w[j]));
+        diff = MAX(diff, abs(thin.w[j] - full.w[j]));
+        diff = MAX(diff, abs(both.w[j] - full.w[j]));
+    }
+
+    bool ok = diff < 1e-12 && !values.vectors && values.u.nrows() == 0 && values.v.nrows() == 0;
+    ok = ok && both.u.nrows() == 0 && abs(values.inv_condition() - full.inv_condition()) < 1e-12;
+    ok = ok && svdError(full, a) < 1e-12 && svdError(thin, a) < 1e-12;
+    printTestResult("SVD Values-Only and Thin Modes", ok);
+}
+
+void testSVDJacobi() {
+    int m = 120, n = 45;
+    MatDoub a(m, n);
+    randomMatrix(a, 21);
+
+    scilib::SVD gr(a);
+    scilib::SVD jac(a, scilib::SVD::JACOBI, 2);
+    scilib::SVD jthin(a, scilib::SVD::JACOBI | scilib::SVD::THIN);
+    scilib::SVD jval(a, scilib::SVD::JACOBI | scilib::SVD::VALUES);
+
+    Doub diff = 0.0;
+    for (int j = 0; j < n; j++) {
+        diff = MAX(diff, abs(jac.w[j] - gr.w[j]));
+        diff = MAX(diff, abs(jthin.w[j] - gr.w[j]));
+        diff = MAX(diff, abs(jval.w[j] - gr.w[j]));
+    }
+    bool ok = diff < 1e-12 && svdError(jac, a) < 1e-12 && svdError(jthin, a) < 1e-12;
+
+    // Q D with graded D: singular values are exactly D, down to 1e-14
+    scilib::QRdcmp qr(a);
+    MatDoub g(m, n);
+    VecDoub d(n);
+    for (int j = 0; j < n; j++) {
+        d[j] = pow(10.0, -14.0 * j / (n - 1));
+        for (int i = 0; i < m; i++) {
+            g[i][j] = qr.qt[j][i] * d[j];
+        }
+    }
+    scilib::SVD graded(g, scilib::SVD::JACOBI | scilib::SVD::VALUES);
+    Doub rel = 0.0;
+    for (int j = 0; j < n; j++) {
+        rel = MAX(rel, abs(graded.w[j] - d[j]) / d[j]);
+    }
+    ok = ok && rel < 1e-12;
+    printTestResult("SVD One-Sided Jacobi", ok);
+}
+
+void testRSVD() {
+    int m = 400, n = 150, r = 12, k = 8;
+    MatDoub x(m, r), y(n, r), a(m, n), ab(m, n);
+    randomMatrix(x, 22);
+    randomMatrix(y, 23);
+    randomMatrix(a, 24);
+    // rank r with a decaying spectrum, plus small noise
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            Doub sum = 0.0;
+            for (int l = 0; l < r; l++) {
+                sum += x[i][l] * y[j][l] * pow(0.5, l);
+            }
+            a[i][j] = sum + 1e-8 * a[i][j];
+        }
+    }
+
+    scilib::SVD full(a);
+    scilib::RSVD rs(a, k, 10, 2, 2);
+    Doub diff = 0.0;
+    for (int j = 0; j < k; j++) {
+        diff = MAX(diff, abs(rs.w[j] - full.w[j]) / full.w[j]);
+    }
+
+    // the rank-k truncation from RSVD is as good as that from the full SVD
+    Doub err = 0.0, best = 0.0;
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            Doub s1 = 0.0, s2 = 0.0;
+            for (int l = 0; l < k; l++) {
+                s1 += rs.u[i][l] * rs.w[l] * rs.v[j][l];
+                s2 += full.u[i][l] * full.w[l] * full.v[j][l];
+            }
+            err = MAX(err, abs(a[i][j] - s1));
+            best = MAX(best, abs(a[i][j] - s2));
+        }
+    }
+
+    MatDoub c, ct;
+    scilib::matmul(a, y, c, 2);
+    scilib::matmul_tn(a, x, ct, 2);
+    Doub mdiff = 0.0;
+    for (int i = 0; i < m; i++) {
+        for (int l = 0; l < r; l++) {
+            Doub sum = 0.0;
+            for (int j = 0; j < n; j++) {
+                sum += a[i][j] * y[j][l];
+            }
+            mdiff = MAX(mdiff, abs(sum - c[i][l]));
+        }
+    }
+    for (int j = 0; j < n; j++) {
+        for (int l = 0; l < r; l++) {
+            Doub sum = 0.0;
+            for (int i = 0; i < m; i++) {
+                sum += a[i][j] * x[i][l];
+            }
+            mdiff = MAX(mdiff, abs(sum - ct[j][l]));
+        }
+    }
+
+    bool ok = diff < 1e-10 && err < 1.5 * best + 1e-12 && mdiff < 1e-12;
+    ok = ok && rs.u.nrows() == m && rs.u.ncols() == k && rs.v.nrows() == n && rs.v.ncols() == k;
+    printTestResult("Randomized SVD", ok);
+}
+
+void testIncSVD() {
+    int m = 60, n = 40, p = 7;
+    MatDoub a(m + 3 * p, n + p);
+    randomMatrix(a, 25);
+    MatDoub a0(m, n), b(p, n), c(m + 3 * p, p);
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            a0[i][j] = a[i][j];
+        }
+    }
+
+    // rows in three batches, then a batch of columns
+    scilib::IncSVD inc(a0);
+    scilib::IncSVD pca(a0, 0, false);
+    for (int t = 0; t < 3; t++) {
+        for (int i = 0; i < p; i++) {
+            for (int j = 0; j < n; j++) {
+                b[i][j] = a[m + t * p + i][j];
+            }
+        }
+        inc.addrows(b);
+        pca.addrows(b);
+    }
+    for (int i = 0; i < m + 3 * p; i++) {
+        for (int j = 0; j < p; j++) {
+            c[i][j] = a[i][n + j];
+        }
+    }
+    MatDoub arows(m + 3 * p, n);
+    for (int i = 0; i < m + 3 * p; i++) {
+        for (int j = 0; j < n; j++) {
+            arows[i][j] = a[i][j];
+        }
+    }
+    scilib::SVD ref(arows);
+    Doub diff = 0.0;
+    for (int j = 0; j < n; j++) {
+        diff = MAX(diff, abs(pca.w[j] - ref.w[j]));
+    }
+    inc.addcols(c);
+
+    scilib::SVD full(a);
+    for (int j = 0; j < n + p; j++) {
+        diff = MAX(diff, abs(inc.w[j] - full.w[j]));
+    }
+    bool ok = diff < 1e-10 && inc.m == m + 3 * p && inc.n == n + p;
+    Doub err = 0.0;
+    for (int i = 0; i < a.nrows(); i++) {
+        for (int j = 0; j < a.ncols(); j++) {
+            Doub sum = 0.0;
+            for (int k = 0; k < inc.w.size(); k++) {
+                sum += inc.u[i][k] * inc.w[k] * inc.v[j][k];
+            }
+            err = MAX(err, abs(sum - a[i][j]));
+        }
+    }
+    ok = ok && err < 1e-10 && pca.u.nrows() == 0;
+
+    // truncated to rank 5 on a rank-5 stream, nothing is lost
+    MatDoub x(m + p, 5), y(n, 5), lr(m + p, n), lr0(m, n);
+    randomMatrix(x, 26);
+    randomMatrix(y, 27);
+    for (int i = 0; i < m + p; i++) {
+        for (int j = 0; j < n; j++) {
+            Doub sum = 0.0;
+            for (int l = 0; l < 5; l++) {
+                sum += x[i][l] * y[j][l];
+            }
+            lr[i][j] = sum;
+            if (i < m) {
+                lr0[i][j] = sum;
+            } else {
+                b[i - m][j] = sum;
+            }
+        }
+    }
+    scilib::IncSVD tr(lr0, 5);
+    tr.addrows(b);
+    scilib::SVD lref(lr);
+    Doub tdiff = 0.0;
+    for (int j = 0; j < 5; j++) {
+        tdiff = MAX(tdiff, abs(tr.w[j] - lref.w[j]));
+    }
+    ok = ok && tdiff < 1e-10 && tr.w.size() == 5 && tr.v.ncols() == 5 && tr.u.nrows() == m + p;
+    printTestResult("Incremental SVD", ok);
+}
+
+void testSVDPrepared() {
+    int m = 50, n = 30, p = 4;
+    MatDoub a(m, n), b(m, p), x(n, p), xs(n, p);
+    randomMatrix(a, 28);
+    randomMatrix(b, 29);
+    for (int i = 0; i < m; i++) {
+        a[i][n - 1] = a[i][0] + a[i][1]; // rank n - 1
+    }
+    scilib::SVD svd(a);
+    VecDoub bv(m), xv(n), xp(n);
+    for (int i = 0; i < m; i++) {
+        bv[i] = b[i][0];
+    }
+
+    // the minimum-norm least-squares solution satisfies A^T (A x - b) = 0 and x in range(V_r)
+    svd.solve(bv, xv);
+    VecDoub r(m);
+    for (int i = 0; i < m; i++) {
+        r[i] = -bv[i];
+        for (int j = 0; j < n; j++) {
+            r[i] += a[i][j] * xv[j];
+        }
+    }
+    Doub grad = 0.0, null = 0.0;
+    for (int j = 0; j < n; j++) {
+        Doub sum = 0.0;
+        for (int i = 0; i < m; i++) {
+            sum += a[i][j] * r[i];
+        }
+        grad = MAX(grad, abs(sum));
+    }
+    MatDoub ns = svd.nullspace();
+    for (int j = 0; j < n; j++) {
+        null += xv[j] * ns[j][0];
+    }
+    bool ok = ns.ncols() == 1 && grad < 1e-12 && abs(null) < 1e-12;
+
+    svd.solve(b, xs);
+    svd.prepare();
+    svd.apply(bv, xp);
+    svd.apply(b, x);
+    ok = ok && svd.pinv.nrows() == n;
+    for (int j = 0; j < n; j++) {
+        ok = ok && abs(xp[j] - xv[j]) < 1e-12 && abs(xs[j][0] - xv[j]) < 1e-12;
+        for (int l = 0; l < p; l++) {
+            ok = ok && abs(x[j][l] - xs[j][l]) < 1e-12;
+        }
+    }
+
+    // a low threshold leaves few values, and the factored form is kept
+    svd.prepare(0.5 * (svd.w[3] + svd.w[4]));
+    svd.apply(b, x);
+    scilib::SVD ref(a);
+    MatDoub xr(n, p);
+    ref.solve(b, xr, 0.5 * (svd.w[3] + svd.w[4]));
+    ok = ok && svd.pinv.nrows() == 0 && svd.pv.ncols() == 4 && maxAbsDiff(x, xr) < 1e-12;
+    printTestResult("SVD Prepared Solve", ok);
+}
+
+void testSVDLazy() {
+    int m = 80, n = 25;
+    MatDoub a(m, n);
+    randomMatrix(a, 30);
+    scilib::SVD full(a, scilib::SVD::THIN);
+    scilib::SVD lazy(a, scilib::SVD::LAZY | scilib::SVD::THIN);
+
+    bool ok = !lazy.vectors && lazy.u.nrows() == 0 && lazy.rank() == n;
+    ok = ok && abs(lazy.inv_condition() - full.inv_condition()) < 1e-12;
+
+    // the first solve forms the vectors
+    VecDoub b(m, 1.0), x(n), xf(n);
+    lazy.solve(b, x);
+    full.solve(b, xf);
+    ok = ok && lazy.vectors && lazy.ain.nrows() == 0 && svdError(lazy, a) < 1e-12;
+    for (int j = 0; j < n; j++) {
+        ok = ok && abs(x[j] - xf[j]) < 1e-12;
+    }
+
+    // forming the vectors keeps the threshold prepare was given
+    scilib::SVD lazy2(a, scilib::SVD::LAZY);
+    Doub thresh = 0.5 * (lazy2.w[n - 4] + lazy2.w[n - 3]);
+    lazy2.prepare(thresh);
+    ok = ok && lazy2.vectors && lazy2.tsh == thresh && lazy2.rank(thresh) == n - 3 && lazy2.pv.ncols() + lazy2.pinv.ncols() > 0;
+    printTestResult("SVD Lazy Vectors", ok);
+}
+
+void testSymmeig() {
+    int n = 90, k = 6;
+    MatDoub b(n, n), a(n, n);
+    randomMatrix(b, 31);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            a[i][j] = b[i][j] + b[j][i];
+        }
+    }
+
+    scilib::Symmeig full(a, 0, 0, 2, 16);
+    scilib::Symmeig values(a, scilib::Symmeig::VALUES);
+    scilib::Symmeig top(a, 0, k);
+
+    // A z_j = d_j z_j, z orthonormal, d decreasing
+    Doub res = 0.0, orth = 0.0, diff = 0.0;
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < n; i++) {
+            Doub sum = -full.d[j] * full.z[i][j];
+            for (int l = 0; l < n; l++) {
+                sum += a[i][l] * full.z[l][j];
+            }
+            res = MAX(res, abs(sum));
+        }
+        for (int jj = 0; jj < n; jj++) {
+            Doub dot = 0.0;
+            for (int i = 0; i < n; i++) {
+                dot += full.z[i][j] * full.z[i][jj];
+            }
+            orth = MAX(orth, abs(dot - (j == jj ? 1.0 : 0.0)));
+        }
+        diff = MAX(diff, abs(values.d[j] - full.d[j]));
+    }
+    bool ok = res < 1e-12 && orth < 1e-12 && diff < 1e-12 && values.z.nrows() == 0;
+    for (int j = 1; j < n; j++) {
+        ok = ok && full.d[j] <= full.d[j - 1];
+    }
+
+    // top-k vectors match the full ones up to sign
+    ok = ok && top.z.ncols() == k;
+    for (int j = 0; j < k; j++) {
+        Doub dot = 0.0;
+        for (int i = 0; i < n; i++) {
+            dot += top.z[i][j] * full.z[i][j];
+        }
+        ok = ok && abs(abs(dot) - 1.0) < 1e-10;
+    }
+
+    // a repeated eigenvalue still gets orthogonal vectors
+    MatDoub c(n, n, 0.0);
+    for (int i = 0; i < n; i++) {
+        c[i][i] = (i < 3 ? 2.0 : 1.0 / (i + 1));
+    }
+    scilib::Symmeig rep(c, 0, 3);
+    for (int j = 0; j < 3; j++) {
+        for (int jj = 0; jj < 3; jj++) {
+            Doub dot = 0.0;
+            for (int i = 0; i < n; i++) {
+                dot += rep.z[i][j] * rep.z[i][jj];
+            }
+            ok = ok && abs(dot - (j == jj ? 1.0 : 0.0)) < 1e-10;
+        }
+    }
+    printTestResult("Symmetric Eigendecomposition", ok);
+}
+
+void testBatchLU() {
+    int n = 5, count = 21;
+    scilib::BatchLU batch(n, count, 2);
+    MatDoub a(n, n), b(count, n), x;
+    randomMatrix(b, 32);
+    vector<MatDoub> mats;
+    for (int k = 0; k < count; k++) {
+        randomMatrix(a, 100 + k);
+        if (k == 7) {
+            for (int j = 0; j < n; j++) {
+                a[3][j] = 2.0 * a[1][j]; // singular
+            }
+        }
+        batch.set(k, a);
+        mats.push_back(a);
+    }
+    batch.factor();
+    batch.solve(b, x);
+
+    bool ok = batch.sing[7] != 0;
+    Doub diff = 0.0;
+    VecDoub bk(n), xk(n);
+    for (int k = 0; k < count; k++) {
+        if (k == 7) {
+            continue;
+        }
+        ok = ok && batch.sing[k] == 0;
+        scilib::LUdcmp lu(mats[k]);
+        for (int i = 0; i < n; i++) {
+            bk[i] = b[k][i];
+        }
+        lu.solve(bk, xk);
+        for (int i = 0; i < n; i++) {
+            diff = MAX(diff, abs(xk[i] - x[k][i]));
+        }
+    }
+
+    // the interleaved solve agrees with the row-wise one
+    VecDoub bi(batch.nchunks * n * scilib::BatchLU::LANES, 0.0);
+    for (int k = 0; k < count; k++) {
+        for (int i = 0; i < n; i++) {
+            bi[((k / scilib::BatchLU::LANES) * n + i) * scilib::BatchLU::LANES + k % scilib::BatchLU::LANES] = b[k][i];
+        }
+    }
+    batch.solve(bi);
+    for (int k = 0; k < count; k++) {
+        if (k == 7) {
+            continue;
+        }
+        for (int i = 0; i < n; i++) {
+            diff = MAX(diff, abs(bi[((k / scilib::BatchLU::LANES) * n + i) * scilib::BatchLU::LANES + k % scilib::BatchLU::LANES] - x[k][i]));
+        }
+    }
+    ok = ok && diff < 1e-10;
+
+    // 32 x 32 storage for 2.2M matrices does not fit in Int
+    bool threw = false;
+    try {
+        scilib::BatchLU huge(32, 2200000);
+    } catch (...) {
+        threw = true;
+    }
+    ok = ok && threw;
+    printTestResult("Batched Small LU", ok);
+}
+
+// max |a - u diag(w) v^T| and max |u^T u - I| + |v^T v - I| over a batch of N x N
+template <int N>
+void smallSVDError(VecDoub_I& a, VecDoub_I& u, VecDoub_I& w, VecDoub_I& v, Doub& err, Doub& orth, bool& sorted) {
+    int count = a.size() / (N * N);
+    err = orth = 0.0;
+    sorted = true;
+    for (int k = 0; k < count; k++) {
+        const Doub *ak = &a[k * N * N], *uk = &u[k * N * N], *wk = &w[k * N], *vk = &v[k * N * N];
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) {
+                Doub sum = 0.0, uu = 0.0, vv = 0.0;
+                for (int l = 0; l < N; l++) {
+                    sum += uk[i * N + l] * wk[l] * vk[j * N + l];
+                    uu += uk[l * N + i] * uk[l * N + j];
+                    vv += vk[l * N + i] * vk[l * N + j];
+                }
+                err = MAX(err, abs(sum - ak[i * N + j]));
+                orth = MAX(orth, abs(uu - (i == j ? 1.0 : 0.0)) + abs(vv - (i == j ? 1.0 : 0.0)));
+            }
+        }
+        for (int l = 1; l < N; l++) {
+            sorted = sorted && wk[l] <= wk[l - 1] && wk[l] >= 0.0;
+        }
+    }
+}
+
+void testSmallSVD() {
+    int count = 37;
+    MatDoub r3(count * 3, 3), r2(count * 2, 2);
+    randomMatrix(r3, 33);
+    randomMatrix(r2, 34);
+    VecDoub a3(count * 9), a2(count * 4), u, w, v, d, z;
+    for (int k = 0; k < count; k++) {
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                a3[k * 9 + i * 3 + j] = r3[k * 3 + i][j];
+            }
+        }
+        for (int i = 0; i < 2; i++) {
+            for (int j = 0; j < 2; j++) {
+                a2[k * 4 + i * 2 + j] = r2[k * 2 + i][j];
+            }
+        }
+    }
+    for (int j = 0; j < 3; j++) {
+        a3[9 + 6 + j] = a3[9 + j] + a3[9 + 3 + j]; // rank 2
+        a3[18 + 3 + j] = a3[18 + 6 + j] = 2.0 * a3[18 + j]; // rank 1
+        a3[27 + 3 * j] = a3[27 + 3 * j + 1] = a3[27 + 3 * j + 2] = 0.0; // zero
+    }
+    a2[4 + 2] = a2[4]; // rank 1
+    a2[4 + 3] = a2[4 + 1];
+
+    Doub err, orth;
+    bool sorted;
+    scilib::svd3x3(a3, u, w, v, 2);
+    smallSVDError<3>(a3, u, w, v, err, orth, sorted);
+    bool ok = err < 1e-14 && orth < 1e-14 && sorted;
+
+    MatDoub m0(3, 3);
+    for (int i = 0; i < 9; i++) {
+        m0[i / 3][i % 3] = a3[i];
+    }
+    scilib::SVD ref(m0);
+    for (int j = 0; j < 3; j++) {
+        ok = ok && abs(ref.w[j] - w[j]) < 1e-14;
+    }
+
+    scilib::svd2x2(a2, u, w, v);
+    smallSVDError<2>(a2, u, w, v, err, orth, sorted);
+    ok = ok && err < 1e-14 && orth < 1e-14 && sorted;
+
+    // extreme scales: the sums of squares would overflow or underflow unscaled
+    const Doub scales[2] = {1e160, 1e-170};
+    VecDoub ax(2 * 9), ax2(2 * 4);
+    for (int k = 0; k < 2; k++) {
+        for (int i = 0; i < 9; i++) {
+            ax[k * 9 + i] = a3[i] * scales[k];
+        }
+        for (int i = 0; i < 4; i++) {
+            ax2[k * 4 + i] = a2[i] * scales[k];
+        }
+    }
+    scilib::svd3x3(ax, u, w, v);
+    smallSVDError<3>(ax, u, w, v, err, orth, sorted);
+    ok = ok && orth < 1e-14 && sorted;
+    for (int k = 0; k < 2; k++) {
+        for (int j = 0; j < 3; j++) {
+            ok = ok && abs(w[k * 3 + j] / scales[k] - ref.w[j]) < 1e-14;
+        }
+    }
+    scilib::svd2x2(ax2, u, w, v);
+    smallSVDError<2>(ax2, u, w, v, err, orth, sorted);
+    ok = ok && orth < 1e-14 && sorted && w[0] / scales[0] > 0.1 && w[2] / scales[1] > 0.1;
+
+    // symmetric parts: A z = z diag(d), d decreasing
+    for (int k = 0; k < count; k++) {
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < i; j++) {
+                a3[k * 9 + j * 3 + i] = a3[k * 9 + i * 3 + j];
+            }
+        }
+        a2[k * 4 + 1] = a2[k * 4 + 2];
+    }
+    a3[36 + 1] = a3[36 + 3] = a3[36 + 2] = a3[36 + 6] = a3[36 + 5] = a3[36 + 7] = 0.0;
+    a3[36] = a3[36 + 4] = 1.0; // already diagonal, repeated eigenvalue
+    Doub res = 0.0;
+    bool dsorted = true;
+    scilib::symeig3x3(a3, d, z, 2);
+    for (int k = 0; k < count; k++) {
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                Doub sum = -z[k * 9 + i * 3 + j] * d[k * 3 + j];
+                for (int l = 0; l < 3; l++) {
+                    sum += a3[k * 9 + i * 3 + l] * z[k * 9 + l * 3 + j];
+                }
+                res = MAX(res, abs(sum));
+            }
+        }
+        dsorted = dsorted && d[k * 3] >= d[k * 3 + 1] && d[k * 3 + 1] >= d[k * 3 + 2];
+    }
+    scilib::symeig2x2(a2, d, z);
+    for (int k = 0; k < count; k++) {
+        for (int i = 0; i < 2; i++) {
+            for (int j = 0; j < 2; j++) {
+                Doub sum = -z[k * 4 + i * 2 + j] * d[k * 2 + j];
+                for (int l = 0; l < 2; l++) {
+                    sum += a2[k * 4 + i * 2 + l] * z[k * 4 + l * 2 + j];
+                }
+                res = MAX(res, abs(sum));
+            }
+        }
+        dsorted = dsorted && d[k * 2] >= d[k * 2 + 1];
+    }
+    ok = ok && res < 1e-14 && dsorted;
+    printTestResult("Batched 2x2 and 3x3 SVD and Eigen", ok);
+}
@@ -7,11 +7,11 @@
 
 // UTILS
 
-bool matricesApproxEqual(const Eigen::MatrixXf& mat1, const Eigen::MatrixXf& mat2, float tol = 1e-5) {
+inline bool matricesApproxEqual(const Eigen::MatrixXf& mat1, const Eigen::MatrixXf& mat2, float tol = 1e-5) {
     return (mat1 - mat2).array().abs().maxCoeff() < tol;
 }
 
-void printTestResult(const std::string& testName, bool result) {
+inline void printTestResult(const std::string& testName, bool result) {
     if (result) {
         std::cout << testName << " passed." << std::endl;
     } else {